@@ -0,0 +1,75 @@
+/**
+ * LZ4 decode throughput of the payload decoder in main.c, on a real
+ * compressed payload: the merged verifier module, packed the way
+ * "make payloads MERGED_VERIFIERS=1" packs it. "make bench" forces that pack
+ * in ahead of src/payloads.h with -include, the same as the tests.
+ *
+ * Reports lz4_decompress on its own and the whole of payload_get
+ * (decompress, xor, adler-32), in MB/s of decoded output and ns per call.
+ * The module is only about a hundred bytes, so the cost per call is a good
+ * part of both numbers.
+ *
+ * This is a native build against tests/stub. For the numbers in the page,
+ * "make bench_page MERGED_VERIFIERS=1" and look at payload_bench.
+ */
+#define main challenge_main
+#include "../src/main.c"
+#undef main
+
+#ifndef PAYLOADS_MERGED
+#error "build with the merged pack, see the Makefile's bench target"
+#endif
+
+// how long each measurement runs for, in milliseconds
+#define BENCH_MS 500
+
+static volatile int s_sink;
+
+static void report(const char* p_label, double p_ms, long p_calls, int p_length)
+{
+    double ns = p_ms * 1e6 / p_calls;
+    printf("%s: %.1f ns/call, %.0f MB/s\n", p_label, ns, p_length * 1e3 / ns);
+}
+
+int main()
+{
+    const unsigned char* header = s_payload_blob + s_payloads[PAYLOAD_MERGED].offset;
+    int length = read_u32(header + 8);
+    int stored = read_u32(header + 12);
+    const unsigned char* block = header + PAYLOAD_HEADER_SIZE + header[6];
+    if ((header[5] & PAYLOAD_FLAG_LZ4) == 0 || payload_get(PAYLOAD_MERGED) == NULL)
+    {
+        printf("the merged payload isn't LZ4 compressed, or doesn't decode\n");
+        return EXIT_FAILURE;
+    }
+    printf("merged module: %d bytes, %d stored\n", length, stored);
+
+    long calls = 0;
+    double start = emscripten_get_now();
+    double elapsed = 0;
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            s_sink = lz4_decompress(s_staging, length, block, stored);
+        }
+        calls += 1000;
+        elapsed = emscripten_get_now() - start;
+    } while (elapsed < BENCH_MS);
+    report("lz4_decompress", elapsed, calls, length);
+
+    calls = 0;
+    start = emscripten_get_now();
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            s_sink = payload_get(PAYLOAD_MERGED) != NULL;
+        }
+        calls += 1000;
+        elapsed = emscripten_get_now() - start;
+    } while (elapsed < BENCH_MS);
+    report("payload_get", elapsed, calls, length);
+
+    return EXIT_SUCCESS;
+}
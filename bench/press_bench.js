@@ -0,0 +1,234 @@
+/**
+ * In-page press benchmark. This gets appended to the emscripten glue with
+ * --post-js by "make bench_page", so it can reach the raw exports the same
+ * way the stage handlers do. Open build/bench/index.html and the numbers are
+ * printed into the page (console.log belongs to the challenge).
+ *
+ * Each entry presses the correct digit for one stage over and over (press_at
+ * puts the engine back on that stage first) and reports the average cost per
+ * press. After that come the decode throughput of each payload in the blob,
+ * the per-check latency of each verifier, what the different ways of calling
+ * into C cost, and whole-code throughput. Last, a couple of seconds of
+ * synthetic 1 kHz input measure how long a press sits in the shim's queue.
+ *
+ * To get a "before" number for a change, build the bench page from the
+ * parent commit and compare.
+ */
+var press_bench_runs = 10000;
+
+// [ label, function taking the digit, digit ]
+var press_benches = [
+    ['stage 1 (1)', function(p_digit) { Module['_press_at'](0, p_digit); }, 1],
+    ['stage 2 (9)', function(p_digit) { Module['_press_at'](1, p_digit); }, 9],
+    ['stage 3 (4)', function(p_digit) { Module['_press_at'](2, p_digit); }, 4],
+    ['stage 4 (7)', function(p_digit) { Module['_press_at'](3, p_digit); }, 7],
+    ['stage 6 (8)', function(p_digit) { Module['_press_at'](5, p_digit); }, 8],
+
+    // the soak loop: three transitions and a reset through the console.log
+    // shim, the way the page sees them. Reported per loop, not per press.
+    ['shim 1 9 4 (0)', function(p_digit) { press_shim(1); press_shim(9); press_shim(4); press_shim(p_digit); press_flush(); }, 0]
+];
+
+// microseconds per call of p_func(p_digit), after a short warm up
+function press_bench_time(p_func, p_digit)
+{
+    for (var i = 0; i < 100; i++)
+    {
+        p_func(p_digit);
+    }
+
+    var start = performance.now();
+    for (var i = 0; i < press_bench_runs; i++)
+    {
+        p_func(p_digit);
+    }
+    return (performance.now() - start) * 1000 / press_bench_runs;
+}
+
+function press_bench()
+{
+    Module['print']('press cost over ' + press_bench_runs + ' presses:');
+    for (var i = 0; i < press_benches.length; i++)
+    {
+        var bench = press_benches[i];
+        var us = press_bench_time(bench[1], bench[2]);
+        Module['print'](bench[0] + ': ' + us.toFixed(3) + ' us/press');
+    }
+}
+
+/**
+ * Decode throughput of payload_get() for every payload in the blob. These
+ * payloads are tiny, so the per-call overhead is a big part of the number.
+ * The default pack stores them all raw. Build with MERGED_VERIFIERS=1 to get
+ * the LZ4 compressed merged module in here instead.
+ */
+function payload_bench()
+{
+    Module['print']('payload_get over ' + press_bench_runs + ' calls:');
+    for (var id = 0; Module['_payload_get'](id) !== 0; id++)
+    {
+        var length = Module['_payload_length'](id);
+        var us = press_bench_time(Module['_payload_get'], id);
+        Module['print']('payload ' + id + ' (' + length + ' bytes): ' + us.toFixed(3) +
+                        ' us, ' + (length / us).toFixed(1) + ' MB/s');
+    }
+}
+
+/**
+ * Per-check latency of a verifier: the linked table slot (call_indirect
+ * straight from C) against the old C -> EM_ASM -> javascript -> verifier
+ * route. Timed inside C (verify_bench) so the javascript calling into the
+ * bench doesn't end up in the numbers.
+ */
+function verify_bench()
+{
+    // [ label, payload id, digit ]
+    var checks = [['stage 2', 0, 9], ['stage 3', 1, 4], ['stage 4', 2, 7], ['stage 5', 3, 4]];
+    Module['print']('verifier check latency over ' + press_bench_runs + ' checks:');
+    for (var i = 0; i < checks.length; i++)
+    {
+        var direct = Module['_verify_bench'](checks[i][1], checks[i][2], press_bench_runs, 1);
+        var js = Module['_verify_bench'](checks[i][1], checks[i][2], press_bench_runs, 0);
+        Module['print'](checks[i][0] + ': ' + direct.toFixed(4) + ' us direct, ' +
+                        js.toFixed(4) + ' us through javascript');
+    }
+}
+
+/**
+ * How much of a press is the call into C. First the bare call overhead, on
+ * payload_length since it does next to nothing: ccall (what every console.log
+ * hook used to do), a cwrap made once, emscripten's Module['_x'] wrapper and
+ * the raw export verifier.js binds. Then whole presses through ccall against
+ * the shim. Pressing 1 over and over alternates between advancing and a
+ * reset, the same work either way, so the difference is ccall's.
+ */
+function ccall_bench()
+{
+    var cwrapped = Module['cwrap']('payload_length', 'number', ['number']);
+    var calls = [
+        ['ccall', function(p_id) { return Module['ccall']('payload_length', 'number', ['number'], [p_id]); }],
+        ['cwrap', cwrapped],
+        ['Module._payload_length', function(p_id) { return Module['_payload_length'](p_id); }],
+        ['raw export', main_export('payload_length')]
+    ];
+    Module['print']('call overhead over ' + press_bench_runs + ' calls:');
+    for (var i = 0; i < calls.length; i++)
+    {
+        var us = press_bench_time(calls[i][1], 0);
+        Module['print'](calls[i][0] + ': ' + us.toFixed(4) + ' us/call');
+    }
+
+    var ccalled = press_bench_time(function(p_digit) { Module['ccall']('press', 'void', ['number'], [p_digit]); }, 1);
+    var shimmed = press_bench_time(function(p_digit) { press_shim(p_digit); press_flush(); }, 1);
+    Module['print']('press via ccall: ' + ccalled.toFixed(3) + ' us, via the shim: ' + shimmed.toFixed(3) +
+                    ' us, ccall is ' + (100 * (ccalled - shimmed) / ccalled).toFixed(1) + '% of a ccall press');
+}
+
+/**
+ * Codes per second through submit_code() against pressing the same code a
+ * digit at a time. The code is right up to a wrong last digit, so both paths
+ * run every check and neither pops the win alert.
+ */
+function submit_bench()
+{
+    var code = [1, 9, 4, 7, 4, 8, 0];
+    var digits = Module['_malloc'](code.length);
+    HEAPU8.set(code, digits);
+
+    var submitted = press_bench_time(function(p_count) { Module['_submit_code'](digits, p_count); }, code.length);
+    var pressed = press_bench_time(function(p_count)
+    {
+        for (var i = 0; i < p_count; i++)
+        {
+            Module['_press_at'](i, code[i]);
+        }
+    }, code.length);
+    Module['_free'](digits);
+
+    Module['print']('whole code over ' + press_bench_runs + ' codes:');
+    Module['print']('submit_code: ' + (1e6 / submitted).toFixed(0) + ' codes/s, ' +
+                    'keypresses: ' + (1e6 / pressed).toFixed(0) + ' codes/s');
+}
+
+/**
+ * Mashes a wrong digit into the shim at about 1 kHz for two seconds (a
+ * MessageChannel loop, since timers get clamped to 4 ms) and reports how long
+ * presses wait between console.log and press_batch, and how big the batches
+ * get. Everything handed over in a frame's press_flush is processed before
+ * that frame is painted, so the wait has to stay under a frame.
+ */
+function mash_bench()
+{
+    var enqueued = [];
+    var waits = [];
+    var batches = 0;
+
+    var flush = press_flush;
+    press_flush = function()
+    {
+        var count = press_queue.length;
+        flush();
+        var now = performance.now();
+        for (var i = 0; i < count; i++)
+        {
+            waits.push(now - enqueued[i]);
+        }
+        enqueued.splice(0, count);
+        batches++;
+    };
+
+    var channel = new MessageChannel();
+    var start = performance.now();
+    var last = 0;
+    channel.port1.onmessage = function()
+    {
+        var now = performance.now();
+        if (now - last >= 1)
+        {
+            last = now;
+            enqueued.push(now);
+            press_shim(3);
+        }
+
+        if (now - start < 2000)
+        {
+            channel.port2.postMessage(0);
+            return;
+        }
+
+        // let the last frame's flush happen
+        requestAnimationFrame(function()
+        {
+            press_flush = flush;
+            waits.sort(function(a, b) { return a - b; });
+            Module['print']('1 kHz mashing, ' + waits.length + ' presses in ' + batches + ' batches (' +
+                            (waits.length / batches).toFixed(1) + ' per batch):');
+            Module['print']('queue wait p50 ' + waits[waits.length >> 1].toFixed(2) + ' ms, p99 ' +
+                            waits[Math.floor(waits.length * 0.99)].toFixed(2) + ' ms, max ' +
+                            waits[waits.length - 1].toFixed(2) + ' ms');
+        });
+    };
+    channel.port2.postMessage(0);
+}
+
+addOnPostRun(function()
+{
+    // load every verifier before timing anything. A press at a stage whose
+    // verifier is still loading doesn't go in (STAGE_PENDING), so the timings
+    // would be of nothing.
+    var loads = [];
+    for (var id = 0; Module['_payload_get'](id) !== 0; id++)
+    {
+        loads.push(verifier_load(id));
+    }
+
+    Promise.all(loads).then(function()
+    {
+        press_bench();
+        payload_bench();
+        verify_bench();
+        ccall_bench();
+        submit_bench();
+        mash_bench();
+    });
+});
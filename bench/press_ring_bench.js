@@ -0,0 +1,213 @@
+/**
+ * Stress test for the worker mode press ring (src/press_ring.js) against
+ * posting every press as a message, which is what worker mode does without
+ * it. The main thread plays the page and a worker_threads worker plays the
+ * challenge's worker, draining presses and doing nothing with them, so this
+ * measures the hand over and not the challenge.
+ *
+ * The ring's consumer is driven the way worker_ring_drain in src/worker.js
+ * does it: drain, then press_ring_wait_async. Once with Atomics.waitAsync
+ * and once with it taken away, which is the doorbell.
+ *
+ * Two runs each:
+ *
+ * - flat out: the producer pushes as fast as it can (backing off for 50 us
+ *   while the ring is full, as the page does with setTimeout), so the
+ *   events/s is what the consumer keeps up with. Latency here is mostly
+ *   time spent queued.
+ * - paced: one press every 100 us, so the consumer is asleep when most of
+ *   them arrive and the latency is the wake up.
+ *
+ * Latency is from the producer's timestamp to the consumer's handler, both
+ * taken as performance.timeOrigin + performance.now().
+ *
+ * Runs under plain node, no emscripten build needed.
+ *
+ * Usage: node bench/press_ring_bench.js
+ */
+var worker_threads = require('worker_threads');
+var ring = require('../src/press_ring.js');
+
+var FLAT_OUT_PRESSES = 1000000;
+var PACED_PRESSES = 20000;
+var PACED_GAP_MS = 0.1;
+var RING_CAPACITY = 256;
+
+function now()
+{
+    return performance.timeOrigin + performance.now();
+}
+
+// sleeps for p_ms without spinning, so on a machine without a spare core the
+// other thread gets to run in the meantime
+var pause_word = new Int32Array(new SharedArrayBuffer(4));
+
+function pause(p_ms)
+{
+    Atomics.wait(pause_word, 0, 0, p_ms);
+}
+
+/*
+ * The consumer. Records each press's latency and, on the digit -1 sentinel,
+ * sends the latencies and the time it finished back.
+ */
+function consume(p_count)
+{
+    var latencies = new Float64Array(p_count);
+    var seen = 0;
+
+    function handle(p_digit, p_session, p_time)
+    {
+        if (p_digit === -1)
+        {
+            worker_threads.parentPort.postMessage({ latencies: latencies, count: seen, end: now() }, [latencies.buffer]);
+            return false;
+        }
+        latencies[seen++] = now() - p_time;
+        return true;
+    }
+
+    return handle;
+}
+
+if (!worker_threads.isMainThread)
+{
+    var setup = worker_threads.workerData;
+    var handle = consume(setup.count);
+
+    if (setup.mode !== 'postMessage')
+    {
+        if (setup.mode === 'doorbell')
+        {
+            delete Atomics.waitAsync;
+        }
+
+        var consumer = ring.press_ring_view(setup.buffer);
+        var running = true;
+        var press = function(p_digit, p_session, p_time)
+        {
+            running = handle(p_digit, p_session, p_time) && running;
+        };
+        var drain = function()
+        {
+            ring.press_ring_drain(consumer, press);
+            if (running)
+            {
+                ring.press_ring_wait_async(consumer, 1000, drain);
+            }
+        };
+
+        worker_threads.parentPort.on('message', function()
+        {
+            ring.press_ring_answer(consumer);
+        });
+        drain();
+    }
+    else
+    {
+        worker_threads.parentPort.on('message', function(p_message)
+        {
+            if (!handle(p_message.value, p_message.session, p_message.time))
+            {
+                worker_threads.parentPort.close();
+            }
+        });
+    }
+    return;
+}
+
+function percentile(p_sorted, p_fraction)
+{
+    return p_sorted[Math.min(p_sorted.length - 1, Math.floor(p_sorted.length * p_fraction))];
+}
+
+/*
+ * Runs p_count presses through p_mode ('ring', 'doorbell' or 'postMessage'),
+ * p_gap ms apart (0 for flat out), and resolves to the consumer's report
+ * plus when the producer started.
+ */
+function run(p_mode, p_count, p_gap)
+{
+    var producer = p_mode !== 'postMessage' ? ring.press_ring_create(RING_CAPACITY) : null;
+    var worker = new worker_threads.Worker(__filename, {
+        workerData: { mode: p_mode, count: p_count, buffer: producer !== null ? producer.buffer : null }
+    });
+
+    var send;
+    if (producer !== null)
+    {
+        producer.doorbell = function()
+        {
+            worker.postMessage({ type: 'ring_doorbell' });
+        };
+        send = function(p_digit, p_time)
+        {
+            while (!ring.press_ring_push(producer, p_digit, 1, p_time))
+            {
+                // full, give the consumer a moment to free a slot
+                pause(0.05);
+            }
+        };
+    }
+    else
+    {
+        send = function(p_digit, p_time)
+        {
+            worker.postMessage({ type: 'press', value: p_digit, session: 1, time: p_time });
+        };
+    }
+
+    return new Promise(function(p_resolve, p_reject)
+    {
+        worker.on('error', p_reject);
+        worker.once('message', function(p_report)
+        {
+            worker.terminate();
+            p_report.start = start;
+            p_resolve(p_report);
+        });
+
+        var start = 0;
+        worker.once('online', function()
+        {
+            start = now();
+            var next = start;
+            for (var i = 0; i < p_count; i++)
+            {
+                if (p_gap > 0)
+                {
+                    next += p_gap;
+                    pause(Math.max(0, next - now()));
+                }
+                send(i % 10, now());
+            }
+            send(-1, now());
+        });
+    });
+}
+
+function report(p_label, p_report)
+{
+    var latencies = Array.prototype.slice.call(p_report.latencies, 0, p_report.count);
+    latencies.sort(function(a, b) { return a - b; });
+    var seconds = (p_report.end - p_report.start) / 1000;
+    console.log(p_label + ': ' + (p_report.count / seconds).toFixed(0) + ' events/s, latency p50 ' +
+                (percentile(latencies, 0.5) * 1000).toFixed(1) + ' us, p99 ' +
+                (percentile(latencies, 0.99) * 1000).toFixed(1) + ' us, max ' +
+                (latencies[latencies.length - 1] * 1000).toFixed(1) + ' us');
+}
+
+async function main()
+{
+    console.log('flat out, ' + FLAT_OUT_PRESSES + ' presses (ring of ' + RING_CAPACITY + '):');
+    report('ring', await run('ring', FLAT_OUT_PRESSES, 0));
+    report('ring, doorbell', await run('doorbell', FLAT_OUT_PRESSES, 0));
+    report('postMessage', await run('postMessage', FLAT_OUT_PRESSES, 0));
+
+    console.log('paced, ' + PACED_PRESSES + ' presses ' + (PACED_GAP_MS * 1000) + ' us apart:');
+    report('ring', await run('ring', PACED_PRESSES, PACED_GAP_MS));
+    report('ring, doorbell', await run('doorbell', PACED_PRESSES, PACED_GAP_MS));
+    report('postMessage', await run('postMessage', PACED_PRESSES, PACED_GAP_MS));
+}
+
+main();
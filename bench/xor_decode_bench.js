@@ -0,0 +1,197 @@
+/**
+ * Compares three ways of running a payload through a single byte xor:
+ *
+ * - per-byte: one JS -> WASM call per byte (what the_end used to do)
+ * - bulk: one decode(ptr, len, key) call, scalar loop inside the module
+ * - simd: one decode_simd(ptr, len, stream, key_len) call. This is the loop
+ *   deobfuscate() in main.c runs when built with -msimd128: the key written
+ *   out key_len + 16 bytes long, 16 bytes of it loaded from wherever the
+ *   key position is for each step, then a scalar tail. Timed with the one
+ *   byte keys the manifest uses, and checked against a five byte key too.
+ *
+ * The decoder is a standalone module so this runs under plain node without
+ * an emscripten build.
+ *
+ * Usage: node bench/xor_decode_bench.js
+ */
+
+/*
+ * (module
+ *  (memory (export "memory") 1)
+ *  (func (export "lolwat") (param i32) (result i32)
+ *   (i32.xor (local.get 0) (i32.const 0xbb)))
+ *  (func (export "decode") (param $ptr i32) (param $len i32) (param $key i32)
+ *   (local $end i32)
+ *   (local.set $end (i32.add (local.get $ptr) (local.get $len)))
+ *   block
+ *    loop
+ *     (br_if 1 (i32.ge_u (local.get $ptr) (local.get $end)))
+ *     (i32.store8 (local.get $ptr)
+ *      (i32.xor (i32.load8_u (local.get $ptr)) (local.get $key)))
+ *     (local.set $ptr (i32.add (local.get $ptr) (i32.const 1)))
+ *     br 0
+ *    end
+ *   end)
+ *  (func (export "decode_simd") (param $ptr i32) (param $len i32) (param $stream i32) (param $key_len i32)
+ *   (local $end i32) (local $k i32)
+ *   (local.set $end (i32.add (local.get $ptr) (local.get $len)))
+ *   block
+ *    loop
+ *     (br_if 1 (i32.gt_u (i32.add (local.get $ptr) (i32.const 16)) (local.get $end)))
+ *     (v128.store (local.get $ptr)
+ *      (v128.xor (v128.load (local.get $ptr))
+ *                (v128.load (i32.add (local.get $stream) (local.get $k)))))
+ *     (local.set $ptr (i32.add (local.get $ptr) (i32.const 16)))
+ *     (local.set $k (i32.rem_u (i32.add (local.get $k) (i32.const 16)) (local.get $key_len)))
+ *     br 0
+ *    end
+ *   end
+ *   block
+ *    loop
+ *     (br_if 1 (i32.ge_u (local.get $ptr) (local.get $end)))
+ *     (i32.store8 (local.get $ptr)
+ *      (i32.xor (i32.load8_u (local.get $ptr))
+ *               (i32.load8_u (i32.add (local.get $stream) (local.get $k)))))
+ *     (local.set $ptr (i32.add (local.get $ptr) (i32.const 1)))
+ *     (if (i32.eq (local.tee $k (i32.add (local.get $k) (i32.const 1))) (local.get $key_len))
+ *      (then (local.set $k (i32.const 0))))
+ *     br 0
+ *    end
+ *   end))
+ */
+var decoder_bytes = new Uint8Array([
+    0,97,115,109,1,0,0,0,1,19,3,96,1,127,1,127,
+    96,3,127,127,127,0,96,4,127,127,127,127,0,3,4,3,
+    0,1,2,5,3,1,0,1,7,42,4,6,109,101,109,111,
+    114,121,2,0,6,108,111,108,119,97,116,0,0,6,100,101,
+    99,111,100,101,0,1,11,100,101,99,111,100,101,95,115,105,
+    109,100,0,2,10,185,1,3,8,0,32,0,65,187,1,115,
+    11,46,1,1,127,32,0,32,1,106,33,3,2,64,3,64,
+    32,0,32,3,79,13,1,32,0,32,0,45,0,0,32,2,
+    115,58,0,0,32,0,65,1,106,33,0,12,0,11,11,11,
+    127,1,2,127,32,0,32,1,106,33,4,2,64,3,64,32,
+    0,65,16,106,32,4,75,13,1,32,0,32,0,253,0,4,
+    0,32,2,32,5,106,253,0,4,0,253,81,253,11,4,0,
+    32,0,65,16,106,33,0,32,5,65,16,106,32,3,112,33,
+    5,12,0,11,11,2,64,3,64,32,0,32,4,79,13,1,
+    32,0,32,0,45,0,0,32,2,32,5,106,45,0,0,115,
+    58,0,0,32,0,65,1,106,33,0,32,5,65,1,106,34,
+    5,32,3,70,4,64,65,0,33,5,11,12,0,11,11,11
+]);
+
+var decoder = new WebAssembly.Instance(new WebAssembly.Module(decoder_bytes)).exports;
+
+// the key stream lives at offset 0, the payload after it (see MAX_SIMD_KEY
+// in main.c for how long a stream gets)
+var STREAM_SIZE = 64;
+
+// stage p_bytes after the key stream in the decoder's memory, growing it to
+// fit
+function stage(p_bytes)
+{
+    var needed = Math.ceil((STREAM_SIZE + p_bytes.length) / 65536) - (decoder.memory.buffer.byteLength / 65536);
+    if (needed > 0)
+    {
+        decoder.memory.grow(needed);
+    }
+
+    var staging = new Uint8Array(decoder.memory.buffer, STREAM_SIZE, p_bytes.length);
+    staging.set(p_bytes);
+    return staging;
+}
+
+// writes p_key out p_key.length + 16 bytes long at offset 0, the way
+// deobfuscate() expands it
+function stream(p_key)
+{
+    var bytes = new Uint8Array(decoder.memory.buffer, 0, p_key.length + 16);
+    for (var i = 0; i < bytes.length; i++)
+    {
+        bytes[i] = p_key[i % p_key.length];
+    }
+}
+
+function per_byte(p_bytes)
+{
+    var out = new Uint8Array(p_bytes.length);
+    for (var i = 0; i < p_bytes.length; i++)
+    {
+        out[i] = decoder.lolwat(p_bytes[i]);
+    }
+    return out;
+}
+
+function bulk(p_bytes)
+{
+    var staging = stage(p_bytes);
+    decoder.decode(STREAM_SIZE, p_bytes.length, 0xbb);
+    return staging;
+}
+
+// p_key defaults to the same one byte key the others use
+function simd(p_bytes, p_key)
+{
+    var key = p_key || [0xbb];
+    var staging = stage(p_bytes);
+    stream(key);
+    decoder.decode_simd(STREAM_SIZE, p_bytes.length, 0, key.length);
+    return staging;
+}
+
+// run p_func until at least 200ms have gone by and return ms per call
+function time(p_func, p_bytes)
+{
+    var runs = 0;
+    var start = process.hrtime.bigint();
+    var elapsed = 0;
+    do
+    {
+        p_func(p_bytes);
+        runs++;
+        elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+    }
+    while (elapsed < 200);
+    return elapsed / runs;
+}
+
+function check(p_name, p_expected, p_actual)
+{
+    for (var i = 0; i < p_expected.length; i++)
+    {
+        if (p_expected[i] !== p_actual[i])
+        {
+            throw new Error(p_name + ' decode mismatch at ' + i + ' for size ' + p_expected.length);
+        }
+    }
+}
+
+var sizes = [100, 1000, 10000, 100000, 1000000];
+console.log('size      per-byte ms   bulk ms       simd ms       bulk x    simd x    simd MB/s');
+for (var i = 0; i < sizes.length; i++)
+{
+    var payload = new Uint8Array(sizes[i]);
+    for (var j = 0; j < payload.length; j++)
+    {
+        payload[j] = (j * 31) & 0xff;
+    }
+
+    var expected = per_byte(payload);
+    check('bulk', expected, bulk(payload));
+    check('simd', expected, simd(payload));
+
+    var key = [0x13, 0x37, 0xc3, 0xaa, 0x55];
+    var keyed = payload.map(function(p_byte, p_at) { return p_byte ^ key[p_at % key.length]; });
+    check('simd, five byte key', keyed, simd(payload, key));
+
+    var slow = time(per_byte, payload);
+    var fast = time(bulk, payload);
+    var fastest = time(simd, payload);
+    console.log(
+        String(sizes[i]).padEnd(10) +
+        slow.toFixed(4).padEnd(14) +
+        fast.toFixed(4).padEnd(14) +
+        fastest.toFixed(4).padEnd(14) +
+        (slow / fast).toFixed(1).padEnd(10) +
+        (slow / fastest).toFixed(1).padEnd(10) +
+        (sizes[i] / fastest / 1000).toFixed(1));
+}
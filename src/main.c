@@ -1,20 +1,11 @@
 /**
  * The problem:
  * This challenge presents the user with a webpage containing 9 buttons. The
- * user must hit the buttons in the right order to "win". The "winning"
- * functions should be called in this order:
- *
- * 1. __syscall80
- * 2. __syscall72
- * 3. __syscall42
- * 4. __syscall18
- * 5. the_end
- * 6. __syscall12
- * 7. __syscall188
- *
- * Why use the __syscall* names? WASM has a bunch of these built in and since
- * function names matter in WASM <-> JS logic, I just decided to go with names
- * that blend in.
+ * user must hit the buttons in the right order to "win". Every press goes
+ * into press(), which looks up the current row of the stage table
+ * (s_stages), checks the digit the way that row says to (a plain compare, a
+ * predicate or one of the verifier payloads) and then moves on, resets or
+ * locks the attacker out. A longer challenge is just more rows.
  *
  * The answer: 1947482
  *
@@ -23,10 +14,11 @@
  * the way this is written actually breaks down to 7, largely independent, key
  * presses that have a 1/10 shot of being correct.
  *
- * Furthermore, successful keypresses *always* result in window.console.log
- * being rewritten. If the attacker is able to observe window.console.log (via
- * debug console) then they can easily determine which digits transition
- * window.console.log to a new function.
+ * Furthermore, successful keypresses *always* result in the stage index in
+ * linear memory moving on. If the attacker is able to observe it (via the
+ * debug console's memory inspector, or just by calling press() and watching
+ * which digits don't reset) then they can easily determine which digits
+ * transition to a new handler.
  *
  * The only anti-debug feature at the moment is the "debugger" keyword.However,
  * since that logic lives in javascript, the attacker should be able to comment
@@ -51,11 +43,10 @@
  * emcc -O3 -s ONLY_MY_CODE=1 -s WASM=1 -s EXTRA_EXPORTED_RUNTIME_METHODS='["ccall"]' main.c -o main.html
  * wasm-strip main.wasm
  *
- * Modifying wat and dumping WASM to C array:
- * wasm2wat main.wasm > main.wat
- * ... write custom wat in main.wat ...
- * wat2wasm main.wat -o lol.wasm
- * xxd -i ./lol.wasm
+ * Modifying the verifiers:
+ * The sources live in src/payloads/ (*.wat). "make payloads" rebuilds
+ * whichever changed and packs them into payloads.h (see
+ * tools/pack_payloads.py and src/payloads/manifest.txt).
  */
 
 #include <stdio.h>
@@ -63,16 +54,60 @@
 #include <string.h>
 #include <time.h>
 #include <emscripten/emscripten.h>
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
 
-// Tracks the time at which __syscall80 was visited.
-static int first_press = 0;
+#include "payloads.h"
 
-// Stored indirect call here to be annoying
-static void (*g_func_ptr)() = 0;
+// Stored indirect call here to be annoying. volatile so the optimizer can't
+// work out there's only ever one thing in it and make the call direct.
+static int (* volatile g_func_ptr)(int) = 0;
 
-// Have we stored log in assert?
+// Have we stored log in assert? Never happens if the host passed
+// hookConsole: false (see "make module"), so the console stays theirs.
 static int log_stored = 0;
 
+// where a board's stage ends up once a stage's lock policy kicks in
+#define STAGE_LOCKED -1
+
+// what session_press and submit_code say when a verifier they need is still
+// loading. Nothing was applied, send the same thing again once it has (the
+// javascript's Module['session_press'] and Module['submit_code'] do that).
+#define STAGE_PENDING -2
+
+// the board owns the page: console.log, the debugger check and the alerts
+#define SESSION_PAGE 0x01
+
+/*
+ * One board's worth of challenge state. The page's own board (s_page, the one
+ * console.log feeds) is one of these too, so any number of boards can share
+ * the module and its linked verifiers without seeing each other's presses.
+ * Each one gets a cache line to itself.
+ */
+typedef struct
+{
+    // the row of s_stages the next press is checked against, or STAGE_LOCKED
+    int stage;
+
+    // time() of the first digit of the current attempt. Checked at later
+    // presses to tell if the button pressing is being automated.
+    int first_press;
+
+    // time() of the last press, for telling idle boards apart
+    int last_press;
+
+    // SESSION_*
+    int flags;
+} __attribute__((aligned(64))) session_t;
+
+static session_t s_page = { 0, 0, 0, SESSION_PAGE };
+
+typedef int (*verifier_t)(int);
+
+// verifiers that have been linked into the function table, by payload id
+static verifier_t s_verifiers[PAYLOAD_COUNT];
+
 /**
  * Executes the debugger keyword in javascript. If the console is up then it
  * will cause the program to pause and the user will have to click through. If
@@ -107,28 +142,60 @@ static int debugger_check()
  *
  * 1. Check for the developer console via the javascript debugger keyword.
  * 2. Inspect the function that executes debugger to see if its been modified.
- * 3. Overwrite console.log to point to __syscall80.
+ * 3. Overwrite console.log with the shim that feeds press().
+ *
+ * Whatever the checks find, the page's board goes back to the first stage.
  *
  * This function is also called when the attacker fails to guess the correct
  * digit. I imagine subversion of this function would be quite bad.
+ *
+ * The Makefile patches it in as the wasm start function by name, so it must
+ * not get inlined into session_step or dropped.
  */
-static void hello()
+static void __attribute__((noinline, used)) hello()
 {
+    // back to the first stage before anything else. If one of the checks
+    // below trips, press() still works, and it mustn't let someone with the
+    // console open keep trying digits at the stage they'd reached.
+    s_page.stage = 0;
+
     // check for dev console.
     if (debugger_check() == 1)
     {
         return;
     }
 
-    // the expected value of ASM_CONSTS[0].
-    char expected[] = "function(){debugger}";
+    // the expected body of the debugger check's EM_ASM, spaces and
+    // semicolons removed.
+    char expected[] = "{debugger}";
 
-    // check to see if the debugger logic was modified
+    // check to see if the debugger logic was modified. fastcomp keeps the
+    // EM_ASM blocks in an array, upstream keys them by the address of their
+    // code and prints them as "function() { ... }" or "() => { ... }". So the
+    // block is found by what's in it: exactly one may mention the keyword
+    // and it mustn't do anything else.
     int result = EM_ASM_INT(
     {
-        var check_js = ASM_CONSTS[0].toString();
         var expected = AsciiToString($0);
-        return check_js == expected;
+        var keyword = expected.slice(1, -1);
+        var found = 0;
+        for (var key in ASM_CONSTS)
+        {
+            var check_js = ASM_CONSTS[key].toString().replace(/[ ;]/g, "");
+            if (check_js.indexOf(keyword) === -1)
+            {
+                continue;
+            }
+
+            var brace = check_js.indexOf('{');
+            var head = check_js.slice(0, brace);
+            if ((head !== 'function()' && head !== '()=>') || check_js.slice(brace) !== expected)
+            {
+                return 0;
+            }
+            found++;
+        }
+        return found === 1;
     }, expected);
 
     if (result != 1)
@@ -144,402 +211,791 @@ static void hello()
         return;
     }
 
-    // reset console.log
-    log_stored = 1;
-    EM_ASM(
+    // reset console.log. The real one only gets stashed the first time
+    // around, after that console.log is already the shim.
+    if (log_stored == 0)
     {
-        window['console']['assert'] = window['console']['log'];
-        window['console']['log'] = function(param)
+        log_stored = EM_ASM_INT(
         {
-            var result = Module.ccall('__syscall80', 'void', ['number'], [param]);
-        }
-    });
-}
-
-/*
- * This is the first digit logic. Basically, if the first digit is 1 then
- * overwrite console.log with the next handler. Otherwise, reset using hello.
- */
-static void call_me_indirectly(int p_value)
-{
-    if (p_value == 1)
-    {
-        EM_ASM(
-        {
-            window['console']['log'] = function(param)
+            if (Module['hookConsole'] === false)
             {
-                var result = Module.ccall('__syscall72', 'void', ['number'], [param]);
+                return 0;
             }
+            window['console']['assert'] = window['console']['log'];
+            return 1;
         });
     }
-    else
+    if (log_stored == 1)
     {
-        hello();
+        EM_ASM(
+        {
+            window['console']['log'] = press_shim;
+        });
     }
 }
 
 /*
- * This is the first digit handler. Indirectly call call_me_indirectly. Just to be
- * annoying. p_value is the value passed into "console.log"
+ * This is the first digit logic. Basically, the first digit has to be 1.
  */
-void EMSCRIPTEN_KEEPALIVE __syscall80(int p_value)
+static int call_me_indirectly(int p_value)
 {
-    // check for dev console.
-    if (debugger_check() == 1)
-    {
-        return;
-    }
-
-    // this is the first half of my bad anti-automation logic. Basically,
-    // store the time of the first keypress. Check time at later keypresses
-    // to determine if the button pressing is being automated.
-    first_press = time(NULL);
-
-    // call call_me_indirectly based on index in the lookup table
-    g_func_ptr(p_value);
+    return p_value == 1;
 }
 
+// longest key the simd path will expand. Anything longer goes scalar.
+#define MAX_SIMD_KEY 32
+
 /*
- * This is the second digit handler. In this one, we hold WASM byte code in
- * a javascript array. The WASM just checks the pressed key is 9. We load
- * the byte code and execute it. Simple!
+ * The one deobfuscation kernel. Every obfuscated payload goes through here.
+ * Byte i of p_in is xor'd with p_key[(p_phase + i) % p_key_len] and written
+ * to p_out, so keys can be any length and roll over the payload. p_phase lets
+ * a caller feed a payload through in pieces. p_out and p_in may be the same.
+ *
+ * Built with -msimd128 this does 16 bytes a step. The key is written out
+ * p_key_len + 16 bytes long so that the 16 bytes of key lined up with any
+ * position in the payload are a single unaligned load. Whatever is left over
+ * (or the whole thing in a non-simd build) goes through the scalar loop.
  */
-void EMSCRIPTEN_KEEPALIVE __syscall72(int p_value)
+static void deobfuscate(unsigned char* p_out, const unsigned char* p_in, int p_len,
+                        const unsigned char* p_key, int p_key_len, int p_phase)
 {
-    int result = EM_ASM_INT(
-    {
-        /**
-         * int oh_no(int p_pressed_key) {
-         *     if (p_pressed_key == 9) {
-         *       return 1;
-         *     }
-         *     return 0;
-         * }
-         */
-        var wasm = new Uint8Array([
-            0,97,115,109,1,0,0,0,1,134,128,128,128,0,1,96,1,127,1,127,3,130,
-            128,128,128,0,1,0,4,132,128,128,128,0,1,112,0,0,5,131,128,128,
-            128,0,1,0,1,6,129,128,128,128,0,0,7,146,128,128,128,0,2,6,109,
-            101,109,111,114,121,2,0,5,111,104,95,110,111,0,0,10,141,128,128,
-            128,0,1,135,128,128,128,0,0,32,0,65,9,70,11
-        ]);
-
-        var module = new WebAssembly.Module(wasm);
-        var module_instance = new WebAssembly.Instance(module);
-        var result = module_instance.exports.oh_no($0);
-        return result;
-    }, p_value);
-
-    if (result == 1)
+    int i = 0;
+    int k = p_phase % p_key_len;
+
+#ifdef __wasm_simd128__
+    if (p_key_len <= MAX_SIMD_KEY)
     {
-        EM_ASM(
+        unsigned char stream[MAX_SIMD_KEY + 16];
+        for (int j = 0; j < p_key_len + 16; j++)
         {
-            window['console']['log'] = function(param)
-            {
-                var result = Module.ccall('__syscall42', 'void', ['number'], [param]);
-            }
-        });
+            stream[j] = p_key[j % p_key_len];
+        }
+
+        for (; i + 16 <= p_len; i += 16)
+        {
+            v128_t data = wasm_v128_load(p_in + i);
+            v128_t key = wasm_v128_load(stream + k);
+            wasm_v128_store(p_out + i, wasm_v128_xor(data, key));
+            k = (k + 16) % p_key_len;
+        }
     }
-    else
+#endif
+
+    for (; i < p_len; i++)
     {
-        hello();
+        p_out[i] = p_in[i] ^ p_key[k];
+        if (++k == p_key_len)
+        {
+            k = 0;
+        }
     }
 }
 
+static unsigned int read_u32(const unsigned char* p_bytes)
+{
+    return p_bytes[0] | (p_bytes[1] << 8) | (p_bytes[2] << 16) | ((unsigned int)p_bytes[3] << 24);
+}
+
+// adler-32 over at most this many bytes can defer the modulo (see zlib)
+#define ADLER_CHUNK 4096
+#define ADLER_BASE 65521
+
 /*
- * This is the third digit handler. In this one, we hold WASM byte code in
- * a C array. This changes where it's stored in memory compared to the second
- * digit handler. The WASM just checks the pressed key is 4. Passing memory
- * into javascript is weird so we have to read the entire thing into a uint8array
- * before we can load and execute.
+ * LZ4 block decompressor. Decodes the p_in_len bytes at p_in into p_out, which
+ * has room for p_out_len bytes. Returns the number of bytes written, or -1 if
+ * the block is malformed or wouldn't fit. Everything is bounds checked since
+ * this runs before the checksum can vouch for the bytes.
  */
-void EMSCRIPTEN_KEEPALIVE __syscall42(int p_value)
-{
-    /*
-     * int oh_no(int p_pressed_key) { 
-     *  if (p_pressed_key == 4) {
-     *      return 1;
-     *  }
-     *  return 0;
-     * }
-     */
-    const char wasm[43] =
-    {
-        0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x06, 0x01, 0x60,
-        0x01, 0x7f, 0x01, 0x7f, 0x03, 0x02, 0x01, 0x00, 0x07, 0x0a, 0x01, 0x06,
-        0x5f, 0x6f, 0x68, 0x5f, 0x6e, 0x6f, 0x00, 0x00, 0x0a, 0x09, 0x01, 0x07,
-        0x00, 0x20, 0x00, 0x41, 0x04, 0x46, 0x0b
-    };
+static int lz4_decompress(unsigned char* p_out, int p_out_len, const unsigned char* p_in, int p_in_len)
+{
+    const unsigned char* in = p_in;
+    const unsigned char* in_end = p_in + p_in_len;
+    unsigned char* out = p_out;
+    unsigned char* out_end = p_out + p_out_len;
 
-    int result = EM_ASM_INT(
+    while (in < in_end)
     {
-        // read the C array into a uint8array
-        var wasm_array = new Uint8Array($2);
-        for (var i = 0; i < $2; i++)
+        unsigned int token = *in++;
+
+        // literals
+        unsigned int length = token >> 4;
+        if (length == 15)
         {
-            wasm_array[i] = getValue($1 + i);
+            unsigned int extra = 255;
+            while (extra == 255)
+            {
+                if (in == in_end)
+                {
+                    return -1;
+                }
+                extra = *in++;
+                length += extra;
+            }
         }
+        if (length > (unsigned int)(in_end - in) || length > (unsigned int)(out_end - out))
+        {
+            return -1;
+        }
+        memcpy(out, in, length);
+        out += length;
+        in += length;
 
-        // compile and execute
-        var module = new WebAssembly.Module(wasm_array);
-        var module_instance = new WebAssembly.Instance(module);
-        var result = module_instance.exports._oh_no($0);
-        return result;
-    }, p_value, wasm, 43);
+        // the last sequence is literals only, and its token says so
+        if (in == in_end)
+        {
+            if ((token & 0x0f) != 0)
+            {
+                return -1;
+            }
+            break;
+        }
 
-    if (result == 1)
-    {
-        EM_ASM(
+        // match
+        if (in_end - in < 2)
+        {
+            return -1;
+        }
+        unsigned int offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > (unsigned int)(out - p_out))
+        {
+            return -1;
+        }
+
+        length = token & 0x0f;
+        if (length == 15)
+        {
+            unsigned int extra = 255;
+            while (extra == 255)
             {
-                window['console']['log'] = function(param)
+                if (in == in_end)
                 {
-                    var result = Module.ccall('__syscall18', 'void', ['number'], [param]);
+                    return -1;
                 }
-            });
-    }
-    else
-    {
-        hello();
+                extra = *in++;
+                length += extra;
+            }
+        }
+        length += 4;
+        if (length > (unsigned int)(out_end - out))
+        {
+            return -1;
+        }
+
+        // a match can overlap what it is writing (that's how runs are encoded)
+        const unsigned char* match = out - offset;
+        if (offset >= length)
+        {
+            memcpy(out, match, length);
+            out += length;
+        }
+        else
+        {
+            while (length-- != 0)
+            {
+                *out++ = *match++;
+            }
+        }
     }
+    return out - p_out;
 }
 
+// payloads get decompressed and deobfuscated in here on their way to the
+// compiler
+static unsigned char s_staging[PAYLOAD_MAX_LENGTH];
+
 /*
- * This is the fourth digit handler. In this one, we hold xor obfuscated WASM
- * byte code in a C array.The C array is deobfuscated before being passed into
- * the javascript.
+ * Validates the container at p_offset in the p_blob_len bytes at p_blob (see
+ * payloads.h) and returns its decoded bytes, or NULL if the container is bad
+ * in any way. Nothing is read outside the blob, whatever the header says.
+ * There is one staging buffer, so the bytes are only good until the next
+ * call.
+ *
+ * A compressed payload is decompressed straight into the staging buffer.
+ * After that, deobfuscating and checksumming happen in the same pass: each
+ * chunk is xor'd into the staging buffer and then folded into the adler-32
+ * while it is still in cache.
  */
-void EMSCRIPTEN_KEEPALIVE __syscall18(int p_value)
+static const unsigned char* payload_decode(const unsigned char* p_blob, unsigned int p_blob_len,
+                                           unsigned int p_offset)
 {
-    /*
-     * int oh_no(int p_pressed_key) { 
-     *  if (p_pressed_key == 7) {
-     *      return 1;
-     *  }
-     *  return 0;
-     * }
-     */
-    char wasm[97] =
+    if (p_offset > p_blob_len || p_blob_len - p_offset < PAYLOAD_HEADER_SIZE)
     {
-        170,203,217,199,171,170,170,170,171,44,42,42,42,170,171,202,
-        171,213,171,213,169,40,42,42,42,170,171,170,174,46,42,42,
-        42,170,171,218,170,170,175,41,42,42,42,170,171,170,171,172,
-        43,42,42,42,170,170,173,56,42,42,42,170,168,172,199,207,
-        199,197,216,211,168,170,175,197,194,245,196,197,170,170,160,39,
-        42,42,42,170,171,45,42,42,42,170,170,138,170,235,173,236,
-        161,
-    };
+        return NULL;
+    }
 
-    for (int i = 0; i < 97; i++)
+    // what's left of the blob after the header, for the key and the payload
+    unsigned int room = p_blob_len - p_offset - PAYLOAD_HEADER_SIZE;
+    const unsigned char* header = p_blob + p_offset;
+    unsigned char flags = header[5];
+    unsigned int key_len = header[6];
+    unsigned int length = read_u32(header + 8);
+    unsigned int stored_length = read_u32(header + 12);
+    if (memcmp(header, PAYLOAD_MAGIC, 4) != 0 || header[4] != PAYLOAD_VERSION ||
+        (flags & ~(PAYLOAD_FLAG_XOR | PAYLOAD_FLAG_LZ4)) != 0 ||
+        ((flags & PAYLOAD_FLAG_XOR) != 0) != (key_len != 0) ||
+        header[7] != 0 ||
+        length > sizeof(s_staging) ||
+        ((flags & PAYLOAD_FLAG_LZ4) == 0 && stored_length != length) ||
+        key_len > room || stored_length > room - key_len)
     {
-        wasm[i] = (wasm[i] ^ 0xaa) & 0xff;
+        return NULL;
     }
 
-    int result = EM_ASM_INT(
+    const unsigned char* key = header + PAYLOAD_HEADER_SIZE;
+    const unsigned char* bytes = key + key_len;
+    if ((flags & PAYLOAD_FLAG_LZ4) != 0)
     {
-        // read the C array into a uint8array
-        var wasm_array = new Uint8Array($2);
-        for (var i = 0; i < $2; i++)
+        if (lz4_decompress(s_staging, length, bytes, stored_length) != (int)length)
         {
-            wasm_array[i] = getValue($1 + i);
+            return NULL;
         }
 
-        // compile and execute
-        var module = new WebAssembly.Module(wasm_array);
-        var module_instance = new WebAssembly.Instance(module);
-        var result = module_instance.exports.oh_no($0);
-        return result;
-    }, p_value, wasm, 97);
+        // the rest happens in place
+        bytes = s_staging;
+    }
 
-    if (result == 1)
+    unsigned int a = 1;
+    unsigned int b = 0;
+    for (unsigned int pos = 0; pos < length; pos += ADLER_CHUNK)
     {
-        EM_ASM(
+        unsigned int count = length - pos < ADLER_CHUNK ? length - pos : ADLER_CHUNK;
+        if (key_len != 0)
+        {
+            deobfuscate(s_staging + pos, bytes + pos, count, key, key_len, pos);
+        }
+        else if (bytes != s_staging)
+        {
+            memcpy(s_staging + pos, bytes + pos, count);
+        }
+
+        for (unsigned int i = 0; i < count; i++)
         {
-            window['console']['log'] = function(param)
+            a += s_staging[pos + i];
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+
+    if (((b << 16) | a) != read_u32(header + 16))
+    {
+        return NULL;
+    }
+    return s_staging;
+}
+
+/*
+ * Returns payload p_id's decoded bytes (see payload_decode), or NULL if its
+ * container failed validation. That is fine for the javascript since the
+ * WebAssembly compiler takes its own copy up front, and the javascript only
+ * asks when it hasn't got the module compiled yet. So in practice each
+ * payload is decoded once per page.
+ */
+const unsigned char* EMSCRIPTEN_KEEPALIVE payload_get(int p_id)
+{
+    if (p_id < 0 || p_id >= PAYLOAD_COUNT)
+    {
+        return NULL;
+    }
+    return payload_decode(s_payload_blob, sizeof(s_payload_blob), s_payloads[p_id].offset);
+}
+
+int EMSCRIPTEN_KEEPALIVE payload_length(int p_id)
+{
+    return read_u32(s_payload_blob + s_payloads[p_id].offset + 8);
+}
+
+const char* EMSCRIPTEN_KEEPALIVE payload_export(int p_id)
+{
+    return s_payloads[p_id].export_name;
+}
+
+/*
+ * 1 if the verifier for payload p_id can be called without compiling
+ * anything on this thread: it's linked, it has loaded, or loading it failed
+ * (verify turns the digit down then). Otherwise makes sure it is loading and
+ * returns 0.
+ */
+static int verifier_ready(int p_id)
+{
+    return s_verifiers[p_id] != 0 || EM_ASM_INT(
+    {
+        return verifier_ready($0);
+    }, p_id);
+}
+
+/*
+ * Runs the verifier for payload p_id against the pressed digit. A stage only
+ * gets presses once its verifier has loaded (see session_step), so
+ * the first time around the javascript just drops the export into a free
+ * slot in our function table. Every check after that is a plain
+ * call_indirect, no javascript involved.
+ *
+ * If the verifier never loaded there's nothing to link. Then the digit is
+ * simply wrong, and the exception is caught here rather than unwinding
+ * through press_batch halfway through a batch. Nothing gets cached, so a
+ * later press asks again.
+ */
+static int verify(int p_id, int p_value)
+{
+    if (s_verifiers[p_id] == 0)
+    {
+        s_verifiers[p_id] = (verifier_t)EM_ASM_INT(
+        {
+            try
             {
-                var result = Module.ccall('the_end', 'void', ['number'], [param]);
+                return verifier_link($0);
             }
-        });
+            catch (err)
+            {
+                return 0;
+            }
+        }, p_id);
+        if (s_verifiers[p_id] == 0)
+        {
+            return 0;
+        }
     }
-    else
+    return s_verifiers[p_id](p_value);
+}
+
+#ifdef PRESS_BENCH
+/*
+ * Only in the bench build (make bench_page). Returns the average microseconds
+ * per check of payload p_id over p_runs checks, either through the linked
+ * table slot or the old C -> javascript -> verifier route.
+ */
+double EMSCRIPTEN_KEEPALIVE verify_bench(int p_id, int p_value, int p_runs, int p_direct)
+{
+    volatile int sink = verify(p_id, p_value);
+    double start = emscripten_get_now();
+    for (int i = 0; i < p_runs; i++)
     {
-        hello();
+        if (p_direct)
+        {
+            sink += s_verifiers[p_id](p_value);
+        }
+        else
+        {
+            sink += EM_ASM_INT(
+            {
+                return verifier_get($0)($1);
+            }, p_id, p_value);
+        }
     }
+    return (emscripten_get_now() - start) * 1000 / p_runs;
 }
+#endif
+
+// how a stage checks its digit
+enum
+{
+    // the digit has to be arg
+    CHECK_EQUALS,
+
+    // the verifier in payload arg has to return 1 for it
+    CHECK_VERIFIER,
+
+    // s_predicates[arg] has to return 1 for it
+    CHECK_PREDICATE
+};
+
+// what a wrong digit, or one that came in too quickly, does
+enum
+{
+    // back to the first stage, via hello()
+    FAIL_RESET,
+
+    // restore console.log and run the lol payload, see lock()
+    FAIL_LOCK
+};
+
+typedef struct
+{
+    unsigned char check;
+    unsigned char arg;
+    unsigned char on_fail;
+
+    // the digit only counts if at least this many seconds have passed since
+    // the first press. 0 for no gate.
+    unsigned char min_seconds;
+} stage_t;
+
+/*
+ * The first digit. Indirectly call call_me_indirectly. Just to be annoying.
+ */
+static int first_digit(int p_value)
+{
+    // call call_me_indirectly through its slot in the function table
+    return g_func_ptr(p_value);
+}
+
+/*
+ * With two digits left there is no need to get crazy. It's a trivial brute
+ * force at this point. This is some very basic bit manipulation to isolate "8"
+ */
+static int sixth_digit(int p_value)
+{
+    return (p_value & 0x03) == 0 && (p_value & 0x04) == 0 && (p_value >> 3) == 1;
+}
+
+enum
+{
+    PREDICATE_FIRST,
+    PREDICATE_SIXTH,
+    PREDICATE_COUNT
+};
+
+static int (* const s_predicates[PREDICATE_COUNT])(int) =
+{
+    first_digit,
+    sixth_digit
+};
 
 /*!
  *
- * This is the fifth digit handler. The attacker has gotten 4/6 digits! If the
- * attacker fails to get this one right then we'll restore console.log to its
- * normal state and execute "lol_wasm" which is just a module that uses the
- * unreachable opcode. Unreachable just triggers a runtime error. Note that
- * restoring the console affectively means the attacker can't interact with the
- * wasm code whereas the unreachable thing is just silliness.
+ * The challenge, one row per digit in the order they have to be pressed.
+ * press() only ever looks at the current row, so a press costs the same
+ * however many rows there are, and each row is four bytes.
  *
- * This code has a little false flag, "you did it" in it. That is dead code.
+ * The second to fifth digits are checked by the verifier payloads. The WASM
+ * just checks the pressed key is 9, then 4 (note the export is "_oh_no" that
+ * time, not "oh_no"), then 7 and 4 again. The last two are xor obfuscated in
+ * the blob, each with a different key, and payload_get runs them through
+ * deobfuscate() before they are passed into the javascript.
  *
- * This function features two WASM byte code payloads. The first is a simple
- * xor deobfuscation and the other is an xor obfuscated payload. All of that
- * is held in javascript.
+ * By the fifth digit the attacker has gotten 4/6 digits! If the attacker
+ * fails to get this one right they get locked out, see lock().
  *
- * This function also does a check to see if digits are being pressed quickly.
- * I, a human person, have triggered this logic. But I've also hit the number
- * combination many many times. So I'm fine with it.
+ * The fifth digit also does a check to see if digits are being pressed
+ * quickly. I, a human person, have triggered this logic. But I've also hit
+ * the number combination many many times. So I'm fine with it.
  */
-void EMSCRIPTEN_KEEPALIVE the_end(int p_value)
+static const stage_t s_stages[] =
 {
-    int result = 0;
-    int are_you_a_bot = time(NULL);
-    if ((are_you_a_bot - first_press) > 1)
-    {
-        result = EM_ASM_INT(
-        {
-            /*
-            * int g_func_ptr(int test) {
-            *  return test ^ 0xbb;
-            * }
-            */
-            var xor_decode = new Uint8Array([
-                0,97,115,109,1,0,0,0,1,134,128,128,128,0,1,96,
-                1,127,1,127,3,130,128,128,128,0,1,0,4,132,128,
-                128,128,0,1,112,0,0,5,131,128,128,128,0,1,0,1,
-                6,129,128,128,128,0,0,7,147,128,128,128,0,2,6,
-                109,101,109,111,114,121,2,0,6,108,111,108,119,
-                97,116,0,0,10,142,128,128,128,0,1,136,128,128,
-                128,0,0,32,0,65,187,1,115,11
-            ]);
-
-            /*
-            * int lolwat(int p_value) {
-            * if (p_value == 4) {
-            *   return 1;
-            * }
-            *   return 0;
-            *}
-            */
-            var wasmCode = new Uint8Array([
-                187,218,200,214,186,187,187,187,186,61,59,59,59,187,186,219,
-                186,196,186,196,184,57,59,59,59,187,186,187,191,63,59,59,
-                59,187,186,203,187,187,190,56,59,59,59,187,186,187,186,189,
-                58,59,59,59,187,187,188,47,59,59,59,187,185,189,214,222,
-                214,212,201,194,185,187,188,204,222,207,200,218,213,223,187,187,
-                177,54,59,59,59,187,186,60,59,59,59,187,187,155,187,250,
-                191,253,176
-            ]);
-
-            var xor_module = new WebAssembly.Module(xor_decode);
-            var xor_instance = new WebAssembly.Instance(xor_module);
-
-            for (var i = 0; i < wasmCode.length; i++)
-            {
-                wasmCode[i] = xor_instance.exports.lolwat(wasmCode[i]);
-            }
+    { CHECK_PREDICATE, PREDICATE_FIRST, FAIL_RESET, 0 },
+    { CHECK_VERIFIER, PAYLOAD_STAGE2, FAIL_RESET, 0 },
+    { CHECK_VERIFIER, PAYLOAD_STAGE3, FAIL_RESET, 0 },
+    { CHECK_VERIFIER, PAYLOAD_STAGE4, FAIL_RESET, 0 },
+    { CHECK_VERIFIER, PAYLOAD_STAGE5, FAIL_LOCK, 2 },
+    { CHECK_PREDICATE, PREDICATE_SIXTH, FAIL_RESET, 0 },
+    { CHECK_EQUALS, 2, FAIL_RESET, 0 }
+};
 
-            var module = new WebAssembly.Module(wasmCode);
-            var module_instance = new WebAssembly.Instance(module);
-            var result = module_instance.exports.wetsand($0);
-            return result;
-        }, p_value);
-    }
+#define STAGE_COUNT ((int)(sizeof(s_stages) / sizeof(s_stages[0])))
 
-    if (result == 1)
+/*
+ * Sends p_session's next press to stage p_stage. If that stage checks its
+ * digit with a verifier that hasn't loaded yet, it starts loading, so it has
+ * the time until the next press to get there. A press that beats it gets
+ * STAGE_PENDING and is held until it has (see session_step). Once a verifier
+ * is linked there's nothing to wait for, so from the second time through a
+ * transition is just the store to the stage. No javascript, nothing
+ * allocated.
+ */
+static void advance(session_t* p_session, int p_stage)
+{
+    p_session->stage = p_stage;
+    if (s_stages[p_stage].check == CHECK_VERIFIER && s_verifiers[s_stages[p_stage].arg] == 0)
     {
         EM_ASM(
         {
-            window['console']['log'] = function(param)
+            verifier_start($0);
+        }, s_stages[p_stage].arg);
+    }
+}
+
+/*
+ * A wrong digit at a FAIL_LOCK stage. We'll restore console.log to its normal
+ * state and execute "lol_wasm" which is just a module that uses the
+ * unreachable opcode. Unreachable just triggers a runtime error. Note that
+ * restoring the console affectively means the attacker can't interact with the
+ * wasm code whereas the unreachable thing is just silliness. The page's board
+ * is locked too, so calling press() directly doesn't help either.
+ *
+ * This code has a little false flag, "you did it" in it. That is dead code.
+ */
+static void lock(int p_value)
+{
+    EM_ASM(
+    {
+        verifier_load($0).then(function(verifier)
+        {
+            // restore console log. disable console error. The challenger won't
+            // will need to refresh the page to get back to the WASM code.
+            if (Module['hookConsole'] !== false)
             {
-                var result = Module.ccall('__syscall12', 'void', ['number'], [param]);
+                delete window['console']['log'];
+                window['console']['log'] = window['console']['assert'];
             }
+
+            // execute
+            verifier($1);
+
+            // this is dead code.
+            important = $2;
+            alert("Whoa! You got it! Email the 7 digit code to solvedthechallenge@tenable.com");
+        }).catch(function(err)
+        {
+            // suppress error
         });
+    }, PAYLOAD_LOL, p_value, call_me_indirectly);
+}
+
+/*
+ * Every digit has been right. As previously stated, the last one is so easy
+ * to brute force that no effort really needs to be made here. I've hidden the
+ * final alert in a base64'd string. It reads:
+ *
+ * alert("Whoa! You got it! Email the 7 digit code to jbaines@tenable.com");
+ */
+static void win()
+{
+    emscripten_run_script("eval(atob('YWxlcnQoJ0dvb2Qgam9iISBZb3UgZGlkIGl0ISBZb3VyIHByaXplIGlzIHRoZSBzYXRpc2ZhY3Rpb24gb2YgYSBqb2Igd2VsbCBkb25lLiBDb25ncmF0cyEnKTs='))");
+}
+
+/*
+ * Returns 1 if p_value is the right digit for p_stage. Just the check, the
+ * timing gate and what happens next are up to the caller.
+ */
+static int check(const stage_t* p_stage, int p_value)
+{
+    switch (p_stage->check)
+    {
+        case CHECK_EQUALS:
+            return p_value == p_stage->arg;
+        case CHECK_VERIFIER:
+            return verify(p_stage->arg, p_value) == 1;
+        case CHECK_PREDICATE:
+            return s_predicates[p_stage->arg](p_value) == 1;
     }
-    else
+    return 0;
+}
+
+/*
+ * Checks p_value against p_session's current row of s_stages and moves the
+ * board on, back to the start or into STAGE_LOCKED. Returns the stage the
+ * next press goes to, or STAGE_COUNT if this press finished the code (the
+ * board is back at the start by then).
+ *
+ * A press for a stage whose verifier is still loading isn't applied at all
+ * and gets STAGE_PENDING. The javascript holds on to it and sends it again
+ * once the load is done: the shim for the page (see press_batch and
+ * verifier_wait), session_wait for other boards.
+ *
+ * Only the page's board does the debugger check, the lock out and the alert.
+ * Other boards just keep score.
+ */
+static int session_step(session_t* p_session, int p_value)
+{
+    if (p_session->stage == STAGE_LOCKED)
     {
-        /*
-         ( module           *
-         ( type (;0;) (func (param i32) (*result i32)))
-         (func (;0;) (type 0) (param i32) (result i32)
-         unreachable)
-         (export "_stage_one" (func 0)))
-         */
-        unsigned char __lol_wasm[43] = {
-            0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x06, 0x01, 0x60,
-            0x01, 0x7f, 0x01, 0x7f, 0x03, 0x02, 0x01, 0x00, 0x07, 0x0e, 0x01, 0x0a,
-            0x5f, 0x73, 0x74, 0x61, 0x67, 0x65, 0x5f, 0x6f, 0x6e, 0x65, 0x00, 0x00,
-            0x0a, 0x05, 0x01, 0x03, 0x00, 0x00, 0x0b
-        };
-        int result = EM_ASM_INT(
+        return STAGE_LOCKED;
+    }
+
+    const stage_t* stage = &s_stages[p_session->stage];
+    if (stage->check == CHECK_VERIFIER && !verifier_ready(stage->arg))
+    {
+        if (p_session->flags & SESSION_PAGE)
         {
-            try
+            EM_ASM(
             {
-                // read the C array into a uint8array
-                var wasm_array = new Uint8Array($1);
-                for (var i = 0; i < $1; i++)
-                {
-                    wasm_array[i] = getValue($0 + i);
-                }
+                verifier_wait($0);
+            }, stage->arg);
+        }
+        else
+        {
+            EM_ASM(
+            {
+                session_wait($0, $1);
+            }, p_session, stage->arg);
+        }
+        return STAGE_PENDING;
+    }
 
-                // restore console log. disable console error. The challenger won't
-                // will need to refresh the page to get back to the WASM code.
-                delete window['console']['log'];
-                window['console']['log'] = window['console']['assert'];
+    int page = p_session->flags & SESSION_PAGE;
+    p_session->last_press = time(NULL);
+    if (p_session->stage == 0)
+    {
+        // check for dev console.
+        if (page && debugger_check() == 1)
+        {
+            return p_session->stage;
+        }
 
-                // compile and execute
-                var module = new WebAssembly.Module(wasm_array);
-                var module_instance = new WebAssembly.Instance(module);
-                module_instance.exports._stage_one($0);
+        // this is the first half of my bad anti-automation logic. Basically,
+        // store the time of the first keypress. Check time at later keypresses
+        // to determine if the button pressing is being automated.
+        p_session->first_press = p_session->last_press;
+    }
 
-                // this is dead code.
-                important = $2;
-                alert("Whoa! You got it! Email the 7 digit code to solvedthechallenge@tenable.com");
-            }
-            catch(err)
+    int result = 0;
+    if (stage->min_seconds == 0 || p_session->last_press - p_session->first_press >= stage->min_seconds)
+    {
+        result = check(stage, p_value);
+    }
+
+    if (result != 1)
+    {
+        if (stage->on_fail == FAIL_LOCK)
+        {
+            p_session->stage = STAGE_LOCKED;
+            if (page)
             {
-                // suppress error
+                lock(p_value);
             }
-        }, __lol_wasm, 43, call_me_indirectly);
+        }
+        else if (page)
+        {
+            hello();
+        }
+        else
+        {
+            p_session->stage = 0;
+        }
+        return p_session->stage;
     }
+
+    if (p_session->stage + 1 < STAGE_COUNT)
+    {
+        advance(p_session, p_session->stage + 1);
+        return p_session->stage;
+    }
+
+    if (page)
+    {
+        win();
+        hello();
+    }
+    else
+    {
+        p_session->stage = 0;
+    }
+    return STAGE_COUNT;
 }
 
 /*
- * With two digits left there is no need to get crazy. It's a trivial brute
- * force at this point. This is some very basic bit manipulation to isolate "8"
+ * Every key press on the page comes in here, via the console.log shim or
+ * called directly.
+ */
+void EMSCRIPTEN_KEEPALIVE press(int p_value)
+{
+    session_step(&s_page, p_value);
+}
+
+/*
+ * A frame's worth of presses from the shim, in the order they came in. Stops
+ * early once the next press has to wait for a verifier to load, the shim
+ * holds on to the rest until it has. Returns how many it got through, which
+ * doesn't count a press that came back STAGE_PENDING.
  */
-void EMSCRIPTEN_KEEPALIVE __syscall12(int p_value)
+int EMSCRIPTEN_KEEPALIVE press_batch(const int* p_values, int p_count)
 {
-    if ((p_value & 0x03) == 0 && (p_value & 0x04) == 0 && (p_value >> 3) == 1)
+    for (int i = 0; i < p_count; i++)
     {
-        EM_ASM(
+        if (session_step(&s_page, p_values[i]) == STAGE_PENDING)
         {
-            window['console']['log'] = function(param)
-            {
-                var result = Module.ccall('__syscall188', 'void', ['number'], [param]);
-            }
-        });
+            return i;
+        }
     }
-    else
+    return p_count;
+}
+
+/*
+ * The page board's stage, or STAGE_LOCKED. Worker mode (src/worker.js) sends
+ * it to the page whenever it changes.
+ */
+int EMSCRIPTEN_KEEPALIVE press_stage()
+{
+    return s_page.stage;
+}
+
+/*
+ * Extra boards, for hosting more than one on a page. Each one is a session_t
+ * on the heap, pressed with session_press (see session_step for what it
+ * returns). They share the module, its memory and the linked verifiers, so
+ * a board costs its 64 bytes and nothing else. Returns NULL when out of
+ * memory.
+ */
+session_t* EMSCRIPTEN_KEEPALIVE session_create()
+{
+    session_t* session = aligned_alloc(sizeof(session_t), sizeof(session_t));
+    if (session != NULL)
     {
-        // reset
-        hello();
+        memset(session, 0, sizeof(session_t));
+    }
+    return session;
+}
+
+int EMSCRIPTEN_KEEPALIVE session_press(session_t* p_session, int p_value)
+{
+    return session_step(p_session, p_value);
+}
+
+void EMSCRIPTEN_KEEPALIVE session_destroy(session_t* p_session)
+{
+    // the page's board isn't on the heap
+    if (p_session != &s_page)
+    {
+        EM_ASM(
+        {
+            delete session_queues[$0];
+        }, p_session);
+        free(p_session);
     }
 }
 
 /*
- * As previously stated, this is so easy to brute force that no effort really
- * needs to be made here. I've hidden the final alert in a base64'd string. It
- * reads:
+ * Checks a whole code in one call, for graders and QA. Same checks as press()
+ * but it leaves the board alone: no timing gate (there's no human to time),
+ * no lock, no reset and no alert. Returns the index of the first stage that
+ * didn't get its digit, where a missing digit counts as wrong and an extra
+ * one fails at STAGE_COUNT, or -1 if the code is right.
  *
- * alert("Whoa! You got it! Email the 7 digit code to jbaines@tenable.com");
+ * On a fresh page the verifiers may not have loaded yet. Then it starts
+ * loading every one the code needs and returns STAGE_PENDING without
+ * checking anything.
  */
-void EMSCRIPTEN_KEEPALIVE __syscall188(int p_value)
+int EMSCRIPTEN_KEEPALIVE submit_code(const unsigned char* p_digits, int p_count)
 {
-    if (p_value == 2)
+    int ready = 1;
+    for (int i = 0; i < STAGE_COUNT && i < p_count; i++)
     {
-        emscripten_run_script("eval(atob('YWxlcnQoJ0dvb2Qgam9iISBZb3UgZGlkIGl0ISBZb3VyIHByaXplIGlzIHRoZSBzYXRpc2ZhY3Rpb24gb2YgYSBqb2Igd2VsbCBkb25lLiBDb25ncmF0cyEnKTs='))");
+        if (s_stages[i].check == CHECK_VERIFIER && !verifier_ready(s_stages[i].arg))
+        {
+            ready = 0;
+        }
+    }
+    if (!ready)
+    {
+        return STAGE_PENDING;
     }
 
-    // reset
-    hello();
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        if (i >= p_count || check(&s_stages[i], p_digits[i]) != 1)
+        {
+            return i;
+        }
+    }
+    return p_count > STAGE_COUNT ? STAGE_COUNT : -1;
 }
 
+#ifdef PRESS_BENCH
+/*
+ * Only in the bench build. Presses p_value at stage p_stage, whatever stage
+ * the page is really at. The first press is backdated so the bot check
+ * doesn't get in the way.
+ */
+void EMSCRIPTEN_KEEPALIVE press_at(int p_stage, int p_value)
+{
+    s_page.stage = p_stage;
+    s_page.first_press = time(NULL) - 60;
+    press(p_value);
+}
+#endif
+
 int main(int p_argc, char** p_argv)
 {
     // the javascript glue invokes the script this way.
@@ -547,15 +1003,23 @@ int main(int p_argc, char** p_argv)
     {
         EM_ASM(
         {
-            delete window['console']['log'];
-            window['console']['log'] = window['console']['assert'];
+            if (Module['hookConsole'] !== false)
+            {
+                delete window['console']['log'];
+                window['console']['log'] = window['console']['assert'];
+            }
             exit(0);
         });
     }
     else
     {
-        // "call_me_indirectly" should be at one given the current code layout.
-        g_func_ptr = 1;
+        // the linker decides which table slot call_me_indirectly gets
+        g_func_ptr = call_me_indirectly;
+
+#ifdef PAYLOADS_MERGED
+        // one compile + instantiate for every stage, while nobody is typing
+        EM_ASM({ verifier_preload($0); }, PAYLOAD_MERGED);
+#endif
     }
 
     return EXIT_SUCCESS;
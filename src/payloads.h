@@ -0,0 +1,127 @@
+/**
+ * GENERATED by tools/pack_payloads.py from src/payloads/manifest.txt. Don't
+ * edit by hand, change the manifest (or the payloads) and run "make payloads".
+ *
+ * Every verifier payload, packed into one read-only blob with an index table
+ * in front of it. The handlers never touch these bytes directly: they ask for
+ * a payload by id (see payload_get() in main.c), which finds the entry here,
+ * validates and decodes it into the staging buffer and hands that to the
+ * javascript.
+ *
+ * Each payload in the blob is a small container:
+ *
+ *   offset  size      field
+ *   0       4         magic, "WCHL"
+ *   4       1         version, PAYLOAD_VERSION
+ *   5       1         flags, PAYLOAD_FLAG_*
+ *   6       1         key length (zero unless PAYLOAD_FLAG_XOR)
+ *   7       1         reserved, zero
+ *   8       4         payload length, little endian
+ *   12      4         stored length, little endian
+ *   16      4         adler-32 of the decoded payload, little endian
+ *   20      key len   xor key, rolled over the payload
+ *   ...     stored    payload
+ *
+ * The payload is xor'd with the key first and then (PAYLOAD_FLAG_LZ4) LZ4
+ * block compressed. The checksum covers the bytes after decoding, so a
+ * corrupt payload and a wrong key are both caught before anything gets near
+ * the compiler.
+ *
+ * id                raw  stored  flags
+ * PAYLOAD_STAGE2     59      59  -
+ * PAYLOAD_STAGE3     43      43  -
+ * PAYLOAD_STAGE4     59      59  xor
+ * PAYLOAD_STAGE5     61      61  xor
+ * PAYLOAD_LOL        43      43  xor
+ */
+#ifndef PAYLOADS_H
+#define PAYLOADS_H
+
+#define PAYLOAD_MAGIC "WCHL"
+#define PAYLOAD_VERSION 2
+#define PAYLOAD_HEADER_SIZE 20
+
+// the payload is xor obfuscated with the key that follows the header
+#define PAYLOAD_FLAG_XOR 0x01
+
+// the (obfuscated) payload is LZ4 block compressed
+#define PAYLOAD_FLAG_LZ4 0x02
+
+// the largest decoded payload, which sizes the staging buffer
+#define PAYLOAD_MAX_LENGTH 61
+
+enum
+{
+    PAYLOAD_STAGE2,
+    PAYLOAD_STAGE3,
+    PAYLOAD_STAGE4,
+    PAYLOAD_STAGE5,
+    PAYLOAD_LOL,
+    PAYLOAD_COUNT
+};
+
+typedef struct
+{
+    // where the container starts in s_payload_blob
+    unsigned int offset;
+
+    // the export the javascript calls with the pressed digit
+    const char* export_name;
+} payload_t;
+
+static const unsigned char s_payload_blob[368] =
+{
+    // PAYLOAD_STAGE2 @ 0: second digit, oh_no(9) == 1
+    0x57, 0x43, 0x48, 0x4c, 0x02, 0x00, 0x00, 0x00, 0x3b, 0x00, 0x00, 0x00,
+    0x3b, 0x00, 0x00, 0x00, 0xaf, 0x09, 0x09, 0x39, 0x00, 0x61, 0x73, 0x6d,
+    0x01, 0x00, 0x00, 0x00, 0x01, 0x06, 0x01, 0x60, 0x01, 0x7f, 0x01, 0x7f,
+    0x02, 0x0f, 0x01, 0x03, 0x65, 0x6e, 0x76, 0x06, 0x6d, 0x65, 0x6d, 0x6f,
+    0x72, 0x79, 0x02, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00, 0x07, 0x09, 0x01,
+    0x05, 0x6f, 0x68, 0x5f, 0x6e, 0x6f, 0x00, 0x00, 0x0a, 0x09, 0x01, 0x07,
+    0x00, 0x20, 0x00, 0x41, 0x09, 0x46, 0x0b,
+
+    // PAYLOAD_STAGE3 @ 79: third digit, _oh_no(4) == 1
+    0x57, 0x43, 0x48, 0x4c, 0x02, 0x00, 0x00, 0x00, 0x2b, 0x00, 0x00, 0x00,
+    0x2b, 0x00, 0x00, 0x00, 0x0c, 0x06, 0x10, 0x8c, 0x00, 0x61, 0x73, 0x6d,
+    0x01, 0x00, 0x00, 0x00, 0x01, 0x06, 0x01, 0x60, 0x01, 0x7f, 0x01, 0x7f,
+    0x03, 0x02, 0x01, 0x00, 0x07, 0x0a, 0x01, 0x06, 0x5f, 0x6f, 0x68, 0x5f,
+    0x6e, 0x6f, 0x00, 0x00, 0x0a, 0x09, 0x01, 0x07, 0x00, 0x20, 0x00, 0x41,
+    0x04, 0x46, 0x0b,
+
+    // PAYLOAD_STAGE4 @ 142: fourth digit, oh_no(7) == 1
+    0x57, 0x43, 0x48, 0x4c, 0x02, 0x01, 0x01, 0x00, 0x3b, 0x00, 0x00, 0x00,
+    0x3b, 0x00, 0x00, 0x00, 0xad, 0x09, 0x03, 0x39, 0xaa, 0xaa, 0xcb, 0xd9,
+    0xc7, 0xab, 0xaa, 0xaa, 0xaa, 0xab, 0xac, 0xab, 0xca, 0xab, 0xd5, 0xab,
+    0xd5, 0xa8, 0xa5, 0xab, 0xa9, 0xcf, 0xc4, 0xdc, 0xac, 0xc7, 0xcf, 0xc7,
+    0xc5, 0xd8, 0xd3, 0xa8, 0xaa, 0xaa, 0xa9, 0xa8, 0xab, 0xaa, 0xad, 0xa3,
+    0xab, 0xaf, 0xc5, 0xc2, 0xf5, 0xc4, 0xc5, 0xaa, 0xaa, 0xa0, 0xa3, 0xab,
+    0xad, 0xaa, 0x8a, 0xaa, 0xeb, 0xad, 0xec, 0xa1,
+
+    // PAYLOAD_STAGE5 @ 222: fifth digit, wetsand(4) == 1
+    0x57, 0x43, 0x48, 0x4c, 0x02, 0x01, 0x01, 0x00, 0x3d, 0x00, 0x00, 0x00,
+    0x3d, 0x00, 0x00, 0x00, 0x91, 0x0a, 0x44, 0x58, 0xbb, 0xbb, 0xda, 0xc8,
+    0xd6, 0xba, 0xbb, 0xbb, 0xbb, 0xba, 0xbd, 0xba, 0xdb, 0xba, 0xc4, 0xba,
+    0xc4, 0xb9, 0xb4, 0xba, 0xb8, 0xde, 0xd5, 0xcd, 0xbd, 0xd6, 0xde, 0xd6,
+    0xd4, 0xc9, 0xc2, 0xb9, 0xbb, 0xbb, 0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xb0,
+    0xba, 0xbc, 0xcc, 0xde, 0xcf, 0xc8, 0xda, 0xd5, 0xdf, 0xbb, 0xbb, 0xb1,
+    0xb2, 0xba, 0xbc, 0xbb, 0x9b, 0xbb, 0xfa, 0xbf, 0xfd, 0xb0,
+
+    // PAYLOAD_LOL @ 304: failure, _stage_one() hits unreachable
+    0x57, 0x43, 0x48, 0x4c, 0x02, 0x01, 0x01, 0x00, 0x2b, 0x00, 0x00, 0x00,
+    0x2b, 0x00, 0x00, 0x00, 0x03, 0x07, 0xba, 0x9c, 0xc3, 0xc3, 0xa2, 0xb0,
+    0xae, 0xc2, 0xc3, 0xc3, 0xc3, 0xc2, 0xc5, 0xc2, 0xa3, 0xc2, 0xbc, 0xc2,
+    0xbc, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xcd, 0xc2, 0xc9, 0x9c, 0xb0, 0xb7,
+    0xa2, 0xa4, 0xa6, 0x9c, 0xac, 0xad, 0xa6, 0xc3, 0xc3, 0xc9, 0xc6, 0xc2,
+    0xc0, 0xc3, 0xc3, 0xc8,
+};
+
+static const payload_t s_payloads[PAYLOAD_COUNT] =
+{
+    { 0, "oh_no" }, // PAYLOAD_STAGE2
+    { 79, "_oh_no" }, // PAYLOAD_STAGE3
+    { 142, "oh_no" }, // PAYLOAD_STAGE4
+    { 222, "wetsand" }, // PAYLOAD_STAGE5
+    { 304, "_stage_one" }, // PAYLOAD_LOL
+};
+
+#endif
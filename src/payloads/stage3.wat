@@ -0,0 +1,6 @@
+;; third digit. Note the leading underscore on the export.
+(module
+  (func (export "_oh_no") (param i32) (result i32)
+    local.get 0
+    i32.const 4
+    i32.eq))
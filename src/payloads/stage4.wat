@@ -0,0 +1,7 @@
+;; fourth digit. xor'd with its own key in the manifest.
+(module
+  (import "env" "memory" (memory 0))
+  (func (export "oh_no") (param i32) (result i32)
+    local.get 0
+    i32.const 7
+    i32.eq))
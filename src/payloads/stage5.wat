@@ -0,0 +1,7 @@
+;; fifth digit. xor'd with a different key than the fourth.
+(module
+  (import "env" "memory" (memory 0))
+  (func (export "wetsand") (param i32) (result i32)
+    local.get 0
+    i32.const 4
+    i32.eq))
@@ -0,0 +1,274 @@
+/**
+ * Single producer, single consumer ring of presses on a SharedArrayBuffer,
+ * for worker mode. The page writes (digit, timestamp, session id) straight
+ * into shared memory and the worker drains it, so a press doesn't go
+ * through postMessage's structured clone and the worker's message queue.
+ *
+ * Shared by the page (a plain <script>), the worker (--pre-js ahead of
+ * worker.js) and bench/press_ring_bench.js (require).
+ *
+ * Layout, in 32 bit words:
+ *
+ *   0  head       next slot the producer writes, only the producer stores it
+ *   1  tail       next slot the consumer reads, only the consumer stores it
+ *   2  sleeping   1 while the consumer is (about to be) parked on head, 2
+ *                 while it's asleep somewhere Atomics can't reach and wants
+ *                 the doorbell rung, 0 otherwise
+ *   3  capacity   slot count, a power of two
+ *
+ * followed by capacity (digit, session) word pairs and then capacity float64
+ * timestamps. head and tail only ever count up and wrap at 2^31, the slot is
+ * the index masked with capacity - 1.
+ *
+ * Nothing here takes a lock. A slot is filled before the Atomics.store of
+ * head that publishes it, and only given back by the Atomics.store of tail
+ * once it has been processed, so each side only needs the other's index.
+ * The producer only pays for an Atomics.notify when the consumer said it
+ * was going to sleep.
+ *
+ * Where there's no Atomics.waitAsync (a worker can't block its own event
+ * loop) the consumer can't park on head, so it asks for the doorbell
+ * instead. The producer calls ring.doorbell() once for that sleep, and on
+ * the page that posts { type: 'ring_doorbell' } to the worker. At typing
+ * speed the worker is asleep for nearly every press, so that's a ring write
+ * and a message each, worse than the message alone. press_ring_available
+ * says no there and the page sticks to postMessage. The doorbell is left
+ * for a worker that turns out not to have waitAsync after all, and for the
+ * bench to show the difference.
+ *
+ * SharedArrayBuffer needs a cross-origin isolated page (served with
+ * Cross-Origin-Opener-Policy: same-origin and
+ * Cross-Origin-Embedder-Policy: require-corp). Without it the page sticks
+ * to postMessage too.
+ */
+
+var PRESS_RING_HEAD = 0;
+var PRESS_RING_TAIL = 1;
+var PRESS_RING_SLEEPING = 2;
+var PRESS_RING_CAPACITY = 3;
+var PRESS_RING_HEADER = 4;
+
+// values of the sleeping word
+var PRESS_RING_AWAKE = 0;
+var PRESS_RING_PARKED = 1;
+var PRESS_RING_DOORBELL = 2;
+
+function press_ring_available()
+{
+    return typeof SharedArrayBuffer === 'function' && typeof Atomics === 'object' &&
+           typeof Atomics.waitAsync === 'function' &&
+           (typeof crossOriginIsolated === 'undefined' || crossOriginIsolated);
+}
+
+/**
+ * Returns a new ring with room for p_capacity presses, rounded up to a power
+ * of two. Hand ring.buffer to the other side and press_ring_view it there.
+ * A producer whose consumer might sleep without Atomics.waitAsync sets
+ * ring.doorbell to something that wakes it.
+ */
+function press_ring_create(p_capacity)
+{
+    var capacity = 1;
+    while (capacity < p_capacity)
+    {
+        capacity <<= 1;
+    }
+
+    // the header keeps the timestamps 8 byte aligned
+    var buffer = new SharedArrayBuffer((PRESS_RING_HEADER + capacity * 2) * 4 + capacity * 8);
+    new Int32Array(buffer)[PRESS_RING_CAPACITY] = capacity;
+    return press_ring_view(buffer);
+}
+
+function press_ring_view(p_buffer)
+{
+    var words = new Int32Array(p_buffer);
+    var capacity = words[PRESS_RING_CAPACITY];
+    return {
+        buffer: p_buffer,
+        words: words,
+        times: new Float64Array(p_buffer, (PRESS_RING_HEADER + capacity * 2) * 4, capacity),
+        mask: capacity - 1,
+        capacity: capacity,
+        doorbell: null,
+        callback: null,
+        timer: null
+    };
+}
+
+/**
+ * Producer side. Returns false, and writes nothing, if the ring is full.
+ */
+function press_ring_push(p_ring, p_digit, p_session, p_time)
+{
+    var words = p_ring.words;
+    var head = words[PRESS_RING_HEAD];
+    if (((head - Atomics.load(words, PRESS_RING_TAIL)) | 0) >= p_ring.capacity)
+    {
+        return false;
+    }
+
+    var slot = head & p_ring.mask;
+    words[PRESS_RING_HEADER + slot * 2] = p_digit;
+    words[PRESS_RING_HEADER + slot * 2 + 1] = p_session;
+    p_ring.times[slot] = p_time;
+    Atomics.store(words, PRESS_RING_HEAD, (head + 1) | 0);
+
+    var sleeping = Atomics.load(words, PRESS_RING_SLEEPING);
+    if (sleeping === PRESS_RING_PARKED)
+    {
+        Atomics.notify(words, PRESS_RING_HEAD);
+    }
+    else if (sleeping === PRESS_RING_DOORBELL && p_ring.doorbell !== null &&
+             Atomics.compareExchange(words, PRESS_RING_SLEEPING, PRESS_RING_DOORBELL, PRESS_RING_AWAKE) === PRESS_RING_DOORBELL)
+    {
+        // whoever takes the word back to awake does the waking, so this
+        // sleep gets exactly one
+        p_ring.doorbell();
+    }
+    return true;
+}
+
+/**
+ * Consumer side. Calls p_handler(digit, session, time) for everything
+ * published so far, in order, then gives the slots back. Returns how many
+ * presses that was.
+ */
+function press_ring_drain(p_ring, p_handler)
+{
+    var words = p_ring.words;
+    var tail = words[PRESS_RING_TAIL];
+    var head = Atomics.load(words, PRESS_RING_HEAD);
+    var count = (head - tail) | 0;
+
+    for (; tail !== head; tail = (tail + 1) | 0)
+    {
+        var slot = tail & p_ring.mask;
+        p_handler(words[PRESS_RING_HEADER + slot * 2], words[PRESS_RING_HEADER + slot * 2 + 1], p_ring.times[slot]);
+    }
+    Atomics.store(words, PRESS_RING_TAIL, tail);
+    return count;
+}
+
+/**
+ * Calls p_callback once something is pushed or p_timeout ms have gone by,
+ * without blocking the thread in the meantime. p_callback always runs from
+ * a later task, never from in here, so a consumer that drains and waits
+ * again from it still gives messages and promises their turn.
+ *
+ * Uses Atomics.waitAsync where there is one. Elsewhere the consumer asks for
+ * the doorbell and the producer's ring.doorbell() has to end up calling
+ * press_ring_answer on this side.
+ */
+function press_ring_wait_async(p_ring, p_timeout, p_callback)
+{
+    var words = p_ring.words;
+    if (typeof Atomics.waitAsync !== 'function')
+    {
+        p_ring.callback = p_callback;
+        Atomics.store(words, PRESS_RING_SLEEPING, PRESS_RING_DOORBELL);
+        var wake = function()
+        {
+            // the doorbell may have beaten us to it, then it's on its way
+            if (Atomics.compareExchange(words, PRESS_RING_SLEEPING, PRESS_RING_DOORBELL, PRESS_RING_AWAKE) === PRESS_RING_DOORBELL)
+            {
+                press_ring_answer(p_ring);
+            }
+        };
+
+        // something pushed before the word went up didn't ring
+        if (Atomics.load(words, PRESS_RING_HEAD) !== words[PRESS_RING_TAIL])
+        {
+            press_ring_defer(wake);
+        }
+        else
+        {
+            p_ring.timer = setTimeout(wake, p_timeout);
+        }
+        return;
+    }
+
+    Atomics.store(words, PRESS_RING_SLEEPING, PRESS_RING_PARKED);
+    var head = Atomics.load(words, PRESS_RING_HEAD);
+    var done = function()
+    {
+        Atomics.store(words, PRESS_RING_SLEEPING, PRESS_RING_AWAKE);
+        p_callback();
+    };
+
+    var result = head === words[PRESS_RING_TAIL] ? Atomics.waitAsync(words, PRESS_RING_HEAD, head, p_timeout) : null;
+    if (result !== null && result.async)
+    {
+        result.value.then(done);
+    }
+    else
+    {
+        press_ring_defer(done);
+    }
+}
+
+/*
+ * Runs p_callback from a task of its own, as soon as the event loop gets to
+ * it. A consumer under steady input comes through here after nearly every
+ * drain, and setTimeout(p_callback, 0) would add its clamp each time: 1 ms
+ * under node, 4 ms in a browser once timeouts nest. A message to ourselves
+ * has no clamp.
+ */
+var press_ring_channel = null;
+var press_ring_deferred = [];
+
+function press_ring_defer(p_callback)
+{
+    if (typeof MessageChannel !== 'function')
+    {
+        setTimeout(p_callback, 0);
+        return;
+    }
+
+    if (press_ring_channel === null)
+    {
+        press_ring_channel = new MessageChannel();
+        press_ring_channel.port1.onmessage = function()
+        {
+            press_ring_deferred.shift()();
+        };
+        // under node, don't keep the process alive for this
+        if (typeof press_ring_channel.port1.unref === 'function')
+        {
+            press_ring_channel.port1.unref();
+        }
+    }
+    press_ring_deferred.push(p_callback);
+    press_ring_channel.port2.postMessage(0);
+}
+
+/**
+ * Consumer side. Runs the callback press_ring_wait_async left waiting for
+ * the doorbell, if it's still waiting.
+ */
+function press_ring_answer(p_ring)
+{
+    var callback = p_ring.callback;
+    if (callback === null)
+    {
+        return;
+    }
+
+    clearTimeout(p_ring.timer);
+    p_ring.callback = null;
+    p_ring.timer = null;
+    callback();
+}
+
+if (typeof module === 'object' && module.exports)
+{
+    module.exports = {
+        press_ring_available: press_ring_available,
+        press_ring_create: press_ring_create,
+        press_ring_view: press_ring_view,
+        press_ring_push: press_ring_push,
+        press_ring_drain: press_ring_drain,
+        press_ring_wait_async: press_ring_wait_async,
+        press_ring_answer: press_ring_answer
+    };
+}
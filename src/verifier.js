@@ -0,0 +1,518 @@
+/**
+ * Shared javascript for the stage verifiers. This gets pulled into the
+ * emscripten glue via --pre-js so it shares scope with the EM_ASM blocks in
+ * main.c.
+ *
+ * The payloads themselves all live in the blob in payloads.h. Verifiers are
+ * identified by their payload id and the bytes are fetched from C with
+ * payload_get() only when a module actually has to be compiled.
+ *
+ * Each verifier is compiled once per page and later presses just call into
+ * the cached export.
+ *
+ * Nothing on the input path compiles synchronously. A stage that passes
+ * starts an async compile + instantiate of the next stage's verifier and
+ * presses are held back until that has resolved, so a verifier can be as big
+ * as it likes without tripping the browsers' 4 KB limit on main thread
+ * compiles or freezing input. Digits pressed in the gap are queued and
+ * replayed, in order, once it's loaded.
+ *
+ * The shim gathers presses up and hands each animation frame's worth to
+ * press_batch() in one call, just before the frame is painted.
+ *
+ * Packed with MERGED_VERIFIERS=1 there's only the one module holding every
+ * verifier, and main() loads it up front with verifier_preload(). Every
+ * stage then waits on that one load instead of its own.
+ */
+
+// payload id -> the verifier's export function
+var verifier_cache = [];
+
+// payload id -> promise of the verifier's export function, while it loads
+var verifier_pending = [];
+
+// payload id -> true once loading it has failed. It isn't tried again.
+var verifier_failed = [];
+
+// verifiers that had to be compiled synchronously because something asked
+// for them before (or without) loading them. Should stay at 0 on the page.
+var verifier_sync_compiles = 0;
+
+// counted once per verifier, by the first press that needs it (see
+// verifier_ready). A hit found it loaded already, by then or by the merged
+// preload. A miss didn't: the press had to wait, or the load failed. Later
+// presses go straight to the linked verifier and never get here.
+var verifier_hits = 0;
+var verifier_misses = 0;
+var verifier_asked = [];
+
+/**
+ * The main module's exports, resolved once on first use and called raw from
+ * then on. Module['_press'] and friends are emscripten's forwarding wrappers,
+ * and the property lookup plus the wrapper is a fair chunk of a press (see
+ * the ccall numbers on the bench page). Can't be done while this file runs,
+ * the module hasn't been instantiated yet.
+ */
+var bound_press_batch = null;
+var bound_payload_get = null;
+var bound_payload_length = null;
+var bound_payload_export = null;
+
+function main_bind()
+{
+    bound_press_batch = main_export('press_batch');
+    bound_payload_get = main_export('payload_get');
+    bound_payload_length = main_export('payload_length');
+    bound_payload_export = main_export('payload_export');
+}
+
+/**
+ * The raw export for C function p_name. Upstream emscripten keys
+ * Module['asm'] by the C name and fastcomp by the symbol, with a leading
+ * underscore. Throws if it's under neither rather than quietly falling
+ * back to the wrapper.
+ */
+function main_export(p_name)
+{
+    var asm = Module['asm'];
+    var func = asm[p_name] || asm['_' + p_name];
+    if (typeof func !== 'function')
+    {
+        throw new Error('no export ' + p_name);
+    }
+    return func;
+}
+
+/**
+ * Returns a HEAPU8 view of payload p_id's deobfuscated bytes. The view sits
+ * on C's staging buffer, so it has to be handed to the compiler (which copies
+ * it) before anything else calls payload_get. Throws if the container failed
+ * validation, which is a lot cheaper than finding out in the compiler.
+ */
+function payload_bytes(p_id)
+{
+    if (bound_payload_get === null)
+    {
+        main_bind();
+    }
+
+    var ptr = bound_payload_get(p_id);
+    if (ptr === 0)
+    {
+        throw new Error('bad payload ' + p_id);
+    }
+    return HEAPU8.subarray(ptr, ptr + bound_payload_length(p_id));
+}
+
+/**
+ * The verifiers don't get a memory of their own. Any that need one import the
+ * main module's, so they work on the heap directly rather than on copies, and
+ * a page doesn't carry a spare 64 KB memory per verifier. Built on first use
+ * because the memory doesn't exist yet when this file runs.
+ */
+var verifier_import_object = null;
+
+function verifier_imports()
+{
+    if (verifier_import_object === null)
+    {
+        var memory = typeof wasmMemory !== 'undefined' ? wasmMemory : Module['wasmMemory'];
+        verifier_import_object = { env: { memory: memory } };
+    }
+    return verifier_import_object;
+}
+
+/**
+ * Returns the export function of the verifier for payload p_id, compiling it
+ * synchronously if it hasn't been loaded yet. Only small payloads survive
+ * that on the main thread, so the page always goes through verifier_load or
+ * verifier_install first. Throws if that load already failed, rather than
+ * trying the same bytes again on the input path.
+ */
+function verifier_get(p_id)
+{
+    var verifier = verifier_cache[p_id];
+    if (verifier === undefined)
+    {
+        if (verifier_failed[p_id])
+        {
+            throw new Error('verifier ' + p_id + ' failed to load');
+        }
+        verifier_sync_compiles++;
+        var instance = new WebAssembly.Instance(new WebAssembly.Module(payload_bytes(p_id)), verifier_imports());
+        verifier = instance.exports[AsciiToString(bound_payload_export(p_id))];
+        verifier_cache[p_id] = verifier;
+    }
+    return verifier;
+}
+
+/**
+ * Compiles and instantiates payload p_id off the input path. Returns a
+ * promise of the instance's exports.
+ */
+function verifier_instantiate(p_id)
+{
+    try
+    {
+        // instantiate copies the bytes before it returns, so the staging
+        // buffer is free again straight away
+        return WebAssembly.instantiate(payload_bytes(p_id), verifier_imports()).then(function(result)
+        {
+            return result.instance.exports;
+        });
+    }
+    catch (err)
+    {
+        return Promise.reject(err);
+    }
+}
+
+/**
+ * Loads the verifier for payload p_id off the input path. Returns a promise
+ * of its export function, shared by everyone asking while it is in flight.
+ */
+function verifier_load(p_id)
+{
+    var verifier = verifier_cache[p_id];
+    if (verifier !== undefined)
+    {
+        return Promise.resolve(verifier);
+    }
+
+    var pending = verifier_pending[p_id];
+    if (pending === undefined)
+    {
+        pending = verifier_instantiate(p_id).then(function(exports)
+        {
+            var verifier = exports[AsciiToString(bound_payload_export(p_id))];
+            verifier_cache[p_id] = verifier;
+            delete verifier_pending[p_id];
+            return verifier;
+        }, function(err)
+        {
+            delete verifier_pending[p_id];
+            verifier_failed[p_id] = true;
+            throw err;
+        });
+        verifier_pending[p_id] = pending;
+    }
+    return pending;
+}
+
+/**
+ * Starts loading payload p_id's verifier unless it has loaded, is loading or
+ * has failed already. Nobody waits on this one, a failure just ends up in
+ * verifier_failed.
+ */
+function verifier_start(p_id)
+{
+    if (verifier_cache[p_id] === undefined && verifier_pending[p_id] === undefined && !verifier_failed[p_id])
+    {
+        verifier_load(p_id).catch(function() {});
+    }
+}
+
+/**
+ * Whether payload p_id's verifier can be called without compiling it on this
+ * thread: it has loaded, or loading it failed. If not, makes sure it's
+ * loading. Called from C when a press needs the verifier and it isn't linked
+ * yet, see verifier_ready in main.c.
+ */
+function verifier_ready(p_id)
+{
+    var loaded = verifier_cache[p_id] !== undefined;
+    if (!verifier_asked[p_id])
+    {
+        verifier_asked[p_id] = true;
+        if (loaded)
+        {
+            verifier_hits++;
+        }
+        else
+        {
+            verifier_misses++;
+        }
+    }
+
+    if (loaded || verifier_failed[p_id])
+    {
+        return 1;
+    }
+    verifier_start(p_id);
+    return 0;
+}
+
+// presses waiting for the next animation frame, or for the current stage's
+// verifier to load. The array is reused so a long session doesn't churn
+// through garbage.
+var press_queue = [];
+var press_waiting = false;
+var press_scheduled = false;
+
+// heap buffer each batch is copied into on its way to press_batch
+var PRESS_BATCH_MAX = 64;
+var press_buffer = 0;
+
+/**
+ * What console.log is while the challenge is running. Queues the digit and
+ * makes sure a flush is coming up on the next animation frame. Created once,
+ * so a transition or reset only ever changes the stage in C.
+ */
+function press_shim(param)
+{
+    press_queue.push(param);
+    if (!press_waiting && !press_scheduled)
+    {
+        press_scheduled = true;
+        if (typeof requestAnimationFrame === 'function')
+        {
+            requestAnimationFrame(press_flush);
+        }
+        else
+        {
+            setTimeout(press_flush, 0);
+        }
+    }
+}
+
+/**
+ * The way in for hosts that keep their console.log (hookConsole: false, see
+ * "make module"). Same queue as console.log on the page, so presses are
+ * batched per frame and held back while a verifier loads.
+ */
+Module['press'] = press_shim;
+
+/**
+ * Hands everything queued to press_batch(), in order, PRESS_BATCH_MAX at a
+ * time. A press that has to wait for a verifier stops the batch, and
+ * whatever press_batch didn't get through stays queued until verifier_wait
+ * flushes again.
+ */
+function press_flush()
+{
+    press_scheduled = false;
+    if (bound_press_batch === null)
+    {
+        main_bind();
+    }
+    // not tied to the binding, a payload load may well have bound it first
+    if (press_buffer === 0)
+    {
+        press_buffer = Module['_malloc'](PRESS_BATCH_MAX * 4);
+    }
+
+    var done = 0;
+    while (done < press_queue.length && !press_waiting)
+    {
+        var count = Math.min(press_queue.length - done, PRESS_BATCH_MAX);
+        for (var i = 0; i < count; i++)
+        {
+            HEAP32[(press_buffer >> 2) + i] = press_queue[done + i];
+        }
+        done += bound_press_batch(press_buffer, count);
+    }
+    press_queue.copyWithin(0, done);
+    press_queue.length -= done;
+}
+
+function press_resume()
+{
+    press_waiting = false;
+    press_flush();
+}
+
+/**
+ * Holds presses back until the verifier for payload p_id has loaded, then
+ * flushes them. If the load fails they go through anyway, and verify in
+ * main.c counts the press as a wrong digit.
+ */
+function verifier_wait(p_id)
+{
+    if (verifier_cache[p_id] !== undefined)
+    {
+        return;
+    }
+
+    press_waiting = true;
+    verifier_load(p_id).then(press_resume, press_resume);
+}
+
+/**
+ * Loads the merged verifier module in payload p_id and fills the cache with
+ * its exports for every payload that points into it (everything listed
+ * before it in the manifest). Until it resolves, loading any of those waits
+ * on it rather than starting a load of its own.
+ */
+function verifier_preload(p_id)
+{
+    var ids = [];
+    for (var id = 0; id < p_id; id++)
+    {
+        ids.push(id);
+    }
+
+    var merged = verifier_instantiate(p_id).then(function(exports)
+    {
+        ids.forEach(function(id)
+        {
+            verifier_cache[id] = exports[AsciiToString(bound_payload_export(id))];
+            delete verifier_pending[id];
+        });
+    }, function()
+    {
+        // fall back to loading them one at a time
+        ids.forEach(function(id)
+        {
+            delete verifier_pending[id];
+        });
+    });
+
+    ids.forEach(function(id)
+    {
+        verifier_pending[id] = merged.then(function()
+        {
+            return verifier_load(id);
+        });
+    });
+}
+
+// same as main.c
+var STAGE_PENDING = -2;
+
+// session_t pointer -> { presses: [[digit, callback]], waiting } for boards
+// pressed through Module['session_press']
+var session_queues = {};
+
+/**
+ * session_press for hosts with boards of their own. Presses go into board
+ * p_session in the order they come in. One that needs a verifier that is
+ * still loading waits, along with everything after it, until it has, so
+ * nothing is compiled on the caller's thread. p_callback (optional) gets
+ * session_press's answer for the press once it has gone in.
+ */
+Module['session_press'] = function(p_session, p_value, p_callback)
+{
+    var queue = session_queues[p_session];
+    if (queue === undefined)
+    {
+        queue = { presses: [], waiting: false };
+        session_queues[p_session] = queue;
+    }
+
+    queue.presses.push([p_value, p_callback]);
+    if (!queue.waiting)
+    {
+        session_flush(p_session);
+    }
+};
+
+function session_flush(p_session)
+{
+    var queue = session_queues[p_session];
+    if (queue === undefined)
+    {
+        return;
+    }
+
+    queue.waiting = false;
+    var done = 0;
+    while (done < queue.presses.length)
+    {
+        var press = queue.presses[done];
+        var stage = Module['_session_press'](p_session, press[0]);
+        if (stage === STAGE_PENDING)
+        {
+            break;
+        }
+
+        done++;
+        if (press[1])
+        {
+            press[1](stage);
+        }
+    }
+    queue.presses.splice(0, done);
+}
+
+/**
+ * Called from C when a press for board p_session has to wait for payload
+ * p_id's verifier to load. Goes through the board's queue again once it has,
+ * or once the load failed (the press then counts as a wrong digit).
+ */
+function session_wait(p_session, p_id)
+{
+    var queue = session_queues[p_session];
+    if (queue !== undefined)
+    {
+        queue.waiting = true;
+    }
+
+    var resume = function()
+    {
+        session_flush(p_session);
+    };
+    (verifier_pending[p_id] || verifier_load(p_id)).then(resume, resume);
+}
+
+/**
+ * submit_code for hosts. p_digits is an array of digits and p_callback gets
+ * submit_code's answer, once every verifier it needs has loaded.
+ */
+Module['submit_code'] = function(p_digits, p_callback)
+{
+    var digits = Module['_malloc'](Math.max(p_digits.length, 1));
+    HEAPU8.set(p_digits, digits);
+    var result = Module['_submit_code'](digits, p_digits.length);
+    Module['_free'](digits);
+    if (result !== STAGE_PENDING)
+    {
+        p_callback(result);
+        return;
+    }
+
+    var retry = function()
+    {
+        Module['submit_code'](p_digits, p_callback);
+    };
+    Promise.all(verifier_pending.filter(Boolean)).then(retry, retry);
+};
+
+// payload id -> function table slot holding the verifier's export
+var verifier_slots = [];
+
+/**
+ * Puts the verifier for payload p_id into the main module's function table
+ * and returns the slot, so C can call it directly with call_indirect. The
+ * export is a real wasm function with the right signature, so it goes into
+ * the table as is rather than behind a javascript wrapper.
+ */
+function verifier_link(p_id)
+{
+    var slot = verifier_slots[p_id];
+    if (slot === undefined)
+    {
+        slot = addFunction(verifier_get(p_id), 'ii');
+        verifier_slots[p_id] = slot;
+    }
+    return slot;
+}
+
+/**
+ * Loader counters, for poking at from the dev console. Fair warning: the
+ * debugger check will take console.log away from you.
+ */
+Module['verifier_stats'] = function()
+{
+    var pending = [];
+    for (var id in verifier_pending)
+    {
+        pending.push(Number(id));
+    }
+    return {
+        loaded: Object.keys(verifier_cache).length,
+        pending: pending,
+        hits: verifier_hits,
+        misses: verifier_misses,
+        sync: verifier_sync_compiles
+    };
+};
@@ -0,0 +1,153 @@
+/**
+ * Worker mode ("make worker"). The whole challenge, verifier compiles and
+ * payload decoding included, runs in a dedicated worker so none of it can
+ * block the page. This gets pulled in with --pre-js after verifier.js and
+ * shares its scope.
+ *
+ * The page (src/worker_shell.html) posts { type: 'press', value: digit } and
+ * gets back:
+ *
+ *   { type: 'ready' }                 the module is up, presses count now
+ *   { type: 'stage', stage: n }       the board moved (STAGE_LOCKED is -1)
+ *   { type: 'alert', text: string }   something wanted to alert()
+ *
+ * Presses go through the same shim as on the page, so they're still batched
+ * per frame and held back while a verifier loads.
+ *
+ * On a cross-origin isolated page with Atomics.waitAsync (see
+ * press_ring_available) the presses come through a shared ring instead
+ * (src/press_ring.js, pulled in ahead of this file). The page posts
+ * { type: 'ring', buffer: SharedArrayBuffer } once and from then on only
+ * writes into it, plus { type: 'ring_doorbell' } if the worker turns out
+ * to be without Atomics.waitAsync and asks to be woken. Everything drained
+ * from the ring in one go is handed to press_batch() straight away, there's
+ * no frame to wait for in here. Session 0 is the board above, any other
+ * session id gets a board of its own (session_create) the first time it
+ * shows up, and its moves come back as { type: 'stage', session: id,
+ * stage: n }.
+ */
+
+// there's no console.log to take over in here
+Module['hookConsole'] = false;
+
+// alert() doesn't exist in a worker. Hand whatever the challenge wanted to
+// say to the page instead.
+self['alert'] = function(p_text)
+{
+    postMessage({ type: 'alert', text: String(p_text) });
+};
+
+// presses that came in before the runtime was up
+var worker_early = [];
+var worker_ready = false;
+
+// the stage last sent to the page
+var worker_stage = 0;
+
+// after every flush, tell the page if the board moved
+var worker_flush = press_flush;
+press_flush = function()
+{
+    worker_flush();
+    var stage = Module['_press_stage']();
+    if (stage !== worker_stage)
+    {
+        worker_stage = stage;
+        postMessage({ type: 'stage', stage: stage });
+    }
+};
+
+// the ring, once the page has sent one, and session id -> [session_t*, stage]
+// for the boards other than the page's
+var worker_ring = null;
+var worker_boards = [];
+
+function worker_ring_press(p_digit, p_session)
+{
+    if (p_session === 0)
+    {
+        press_queue.push(p_digit);
+        return;
+    }
+
+    var board = worker_boards[p_session];
+    if (board === undefined)
+    {
+        board = [Module['_session_create'](), 0];
+        worker_boards[p_session] = board;
+    }
+    if (board[0] === 0)
+    {
+        return;
+    }
+
+    Module['session_press'](board[0], p_digit, function(p_stage)
+    {
+        if (p_stage !== board[1])
+        {
+            board[1] = p_stage;
+            postMessage({ type: 'stage', session: p_session, stage: p_stage });
+        }
+    });
+}
+
+function worker_ring_drain()
+{
+    press_ring_drain(worker_ring, worker_ring_press);
+    if (press_queue.length > 0 && !press_waiting)
+    {
+        press_flush();
+    }
+    press_ring_wait_async(worker_ring, 1000, worker_ring_drain);
+}
+
+Module['onRuntimeInitialized'] = function()
+{
+    worker_ready = true;
+    for (var i = 0; i < worker_early.length; i++)
+    {
+        press_shim(worker_early[i]);
+    }
+    worker_early = null;
+    postMessage({ type: 'ready' });
+
+    // whatever the page wrote before now has been sitting in the ring
+    if (worker_ring !== null)
+    {
+        worker_ring_drain();
+    }
+};
+
+self.onmessage = function(p_event)
+{
+    var message = p_event.data;
+    if (message.type === 'ring' && worker_ring === null)
+    {
+        worker_ring = press_ring_view(message.buffer);
+        if (worker_ready)
+        {
+            worker_ring_drain();
+        }
+        return;
+    }
+
+    if (message.type === 'ring_doorbell' && worker_ring !== null)
+    {
+        press_ring_answer(worker_ring);
+        return;
+    }
+
+    if (message.type !== 'press')
+    {
+        return;
+    }
+
+    if (worker_ready)
+    {
+        press_shim(message.value);
+    }
+    else
+    {
+        worker_early.push(message.value);
+    }
+};
@@ -0,0 +1,149 @@
+/**
+ * Native tests for deobfuscate() in main.c against a plain reference loop.
+ * The payloads in the manifest all have one byte keys and none is anywhere
+ * near 4 KB, so the rolling key and p_phase never get a workout from
+ * payload_test.c. This goes through every key length from 1 to 40 (past
+ * MAX_SIMD_KEY, where the simd build goes scalar), a spread of phases and
+ * lengths either side of the 16 byte steps, in place and not, and a payload
+ * fed through in pieces.
+ *
+ * "make test" builds it twice, the second time with __wasm_simd128__ defined
+ * and tests/stub/wasm_simd128.h standing in for the real intrinsics. Buffers
+ * are heap copies of exactly the size given, as in payload_test.c.
+ */
+#define main challenge_main
+#include "../src/main.c"
+#undef main
+
+#define MAX_KEY 40
+
+static int s_failures = 0;
+
+static void reference(unsigned char* p_out, const unsigned char* p_in, int p_len,
+                      const unsigned char* p_key, int p_key_len, int p_phase)
+{
+    for (int i = 0; i < p_len; i++)
+    {
+        p_out[i] = p_in[i] ^ p_key[(p_phase + i) % p_key_len];
+    }
+}
+
+static unsigned char* filled(int p_len, int p_seed)
+{
+    unsigned char* bytes = malloc(p_len != 0 ? p_len : 1);
+    for (int i = 0; i < p_len; i++)
+    {
+        bytes[i] = (i * 31 + p_seed * 7 + 1) & 0xff;
+    }
+    return bytes;
+}
+
+static void compare(const unsigned char* p_expected, const unsigned char* p_actual, int p_len,
+                    const char* p_what, int p_key_len, int p_phase)
+{
+    for (int i = 0; i < p_len; i++)
+    {
+        if (p_expected[i] != p_actual[i])
+        {
+            printf("FAIL: %s, key %d, phase %d, length %d, at %d\n", p_what, p_key_len, p_phase, p_len, i);
+            s_failures++;
+            return;
+        }
+    }
+}
+
+static void test_against_reference()
+{
+    static const int lengths[] = { 0, 1, 7, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 101, 255, 4097 };
+    for (int key_len = 1; key_len <= MAX_KEY; key_len++)
+    {
+        unsigned char* key = filled(key_len, key_len);
+        int phases[] = { 0, 1, key_len - 1, key_len, key_len + 3, 16, 4095 };
+
+        for (unsigned int p = 0; p < sizeof(phases) / sizeof(phases[0]); p++)
+        {
+            for (unsigned int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+            {
+                int len = lengths[l];
+                unsigned char* in = filled(len, 3);
+                unsigned char* expected = malloc(len != 0 ? len : 1);
+                unsigned char* out = malloc(len != 0 ? len : 1);
+                reference(expected, in, len, key, key_len, phases[p]);
+
+                deobfuscate(out, in, len, key, key_len, phases[p]);
+                compare(expected, out, len, "into another buffer", key_len, phases[p]);
+
+                deobfuscate(in, in, len, key, key_len, phases[p]);
+                compare(expected, in, len, "in place", key_len, phases[p]);
+
+                free(out);
+                free(expected);
+                free(in);
+            }
+        }
+        free(key);
+    }
+}
+
+/*
+ * A payload decoded in uneven pieces, each starting where the last left off
+ * in the key, has to come out the same as in one go.
+ */
+static void test_pieces()
+{
+    static const int pieces[] = { 1, 16, 5, 33, 100, 17, 4096, 3 };
+    int len = 0;
+    for (unsigned int i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++)
+    {
+        len += pieces[i];
+    }
+
+    for (int key_len = 1; key_len <= MAX_KEY; key_len++)
+    {
+        unsigned char* key = filled(key_len, key_len + 1);
+        unsigned char* in = filled(len, 5);
+        unsigned char* expected = malloc(len);
+        unsigned char* out = malloc(len);
+        reference(expected, in, len, key, key_len, 0);
+
+        int at = 0;
+        for (unsigned int i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++)
+        {
+            unsigned char* piece = malloc(pieces[i]);
+            memcpy(piece, in + at, pieces[i]);
+            deobfuscate(piece, piece, pieces[i], key, key_len, at);
+            memcpy(out + at, piece, pieces[i]);
+            free(piece);
+            at += pieces[i];
+        }
+        compare(expected, out, len, "in pieces", key_len, 0);
+
+        free(out);
+        free(expected);
+        free(in);
+        free(key);
+    }
+}
+
+int main()
+{
+    test_against_reference();
+    test_pieces();
+
+#ifdef __wasm_simd128__
+    if (wasm_stub_loads == 0)
+    {
+        printf("FAIL: the simd path never ran\n");
+        s_failures++;
+    }
+    printf("simd loads: %d\n", wasm_stub_loads);
+#endif
+
+    if (s_failures != 0)
+    {
+        printf("%d failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    printf("ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+/**
+ * Native tests for the payload decoder in main.c: payload_get, the container
+ * checks behind it (payload_decode) and lz4_decompress. main.c is built in
+ * whole against the stub emscripten.h in tests/stub, so the static functions
+ * can be called directly. "make test" builds this with ASan and UBSan. Every
+ * buffer handed to the decoder is a heap copy of exactly the size it is told,
+ * so reading a byte too far fails the run even when the result would have
+ * been thrown away.
+ *
+ * The blob tested is whichever payloads.h main.c gets. "make test" runs it
+ * against src/payloads.h and again with a merged pack forced in ahead of it
+ * (-include), since that's the one payload that ends up LZ4 compressed.
+ */
+#define main challenge_main
+#include "../src/main.c"
+#undef main
+
+static int s_failures = 0;
+
+static void expect(int p_ok, const char* p_what, unsigned int p_at)
+{
+    if (!p_ok)
+    {
+        printf("FAIL: %s (at %u)\n", p_what, p_at);
+        s_failures++;
+    }
+}
+
+// a heap copy of the first p_len bytes of p_bytes, so ASan knows where it ends
+static unsigned char* copy(const unsigned char* p_bytes, unsigned int p_len)
+{
+    unsigned char* bytes = malloc(p_len != 0 ? p_len : 1);
+    memcpy(bytes, p_bytes, p_len);
+    return bytes;
+}
+
+static unsigned int container_size(const unsigned char* p_blob, unsigned int p_offset)
+{
+    return PAYLOAD_HEADER_SIZE + p_blob[p_offset + 6] + read_u32(p_blob + p_offset + 12);
+}
+
+/*
+ * Every container in the blob has to decode to a wasm module. Then every
+ * single bit flip has to be turned away by the container it lands in and
+ * leave the others alone, and so does every truncation of the blob that
+ * cuts into a container.
+ */
+static void test_blob(const unsigned char* p_blob, unsigned int p_len)
+{
+    printf("blob: %u bytes\n", p_len);
+    unsigned char* blob = copy(p_blob, p_len);
+
+    unsigned int offsets[64];
+    int count = 0;
+    for (unsigned int offset = 0; offset < p_len && count < 64; offset += container_size(blob, offset))
+    {
+        const unsigned char* bytes = payload_decode(blob, p_len, offset);
+        expect(bytes != NULL && memcmp(bytes, "\0asm", 4) == 0, "decodes to a wasm module", offset);
+        if (bytes == NULL)
+        {
+            free(blob);
+            return;
+        }
+        offsets[count++] = offset;
+    }
+
+    for (unsigned int at = 0; at < p_len; at++)
+    {
+        for (int bit = 0; bit < 8; bit++)
+        {
+            blob[at] ^= 1 << bit;
+            for (int i = 0; i < count; i++)
+            {
+                unsigned int end = offsets[i] + container_size(p_blob, offsets[i]);
+                int hit = at >= offsets[i] && at < end;
+                int decoded = payload_decode(blob, p_len, offsets[i]) != NULL;
+                expect(decoded != hit, hit ? "bit flip rejected" : "bit flip elsewhere ignored", at);
+            }
+            blob[at] ^= 1 << bit;
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        unsigned int end = offsets[i] + container_size(p_blob, offsets[i]);
+        for (unsigned int len = offsets[i]; len < end; len++)
+        {
+            unsigned char* cut = copy(p_blob, len);
+            expect(payload_decode(cut, len, offsets[i]) == NULL, "truncated blob rejected", len);
+            free(cut);
+        }
+        expect(payload_decode(blob, p_len, end + p_len) == NULL, "offset past the end rejected", end + p_len);
+    }
+
+    free(blob);
+}
+
+/*
+ * The LZ4 blocks in the blob have to decompress to exactly their payload
+ * length. A block with its tail cut off, or an output buffer a byte short,
+ * must not.
+ */
+static void test_lz4_blocks(const unsigned char* p_blob, unsigned int p_len)
+{
+    for (unsigned int offset = 0; offset < p_len; offset += container_size(p_blob, offset))
+    {
+        if ((p_blob[offset + 5] & PAYLOAD_FLAG_LZ4) == 0)
+        {
+            continue;
+        }
+
+        int length = read_u32(p_blob + offset + 8);
+        int stored = read_u32(p_blob + offset + 12);
+        const unsigned char* block = p_blob + offset + PAYLOAD_HEADER_SIZE + p_blob[offset + 6];
+        printf("lz4 block at %u: %d -> %d bytes\n", offset, stored, length);
+
+        unsigned char* out = malloc(length);
+        unsigned char* in = copy(block, stored);
+        expect(lz4_decompress(out, length, in, stored) == length, "lz4 block decompresses", offset);
+        expect(lz4_decompress(out, length - 1, in, stored) == -1, "lz4 block into too small a buffer", offset);
+        free(in);
+
+        for (int len = 0; len < stored; len++)
+        {
+            in = copy(block, len);
+            expect(lz4_decompress(out, length, in, len) != length, "truncated lz4 block", len);
+            free(in);
+        }
+        free(out);
+    }
+}
+
+/*
+ * Hand made blocks that each break one rule, then a pile of random ones.
+ * The random ones only have to not crash.
+ */
+static void test_lz4_malformed()
+{
+    static const struct
+    {
+        const char* what;
+        unsigned char bytes[8];
+        int len;
+        int out_len;
+        int result;
+    } cases[] =
+    {
+        { "literals only", { 0x30, 'a', 'b', 'c' }, 4, 3, 3 },
+        { "run through an overlapping match", { 0x15, 'a', 0x01, 0x00, 0x00 }, 5, 10, 10 },
+        { "last token with a match length", { 0x31, 'a', 'b', 'c' }, 4, 3, -1 },
+        { "literals past the input", { 0x40, 'a', 'b' }, 3, 16, -1 },
+        { "literals past the output", { 0x30, 'a', 'b', 'c' }, 4, 2, -1 },
+        { "literal length runs off the input", { 0xf0, 0xff, 0xff }, 3, 1024, -1 },
+        { "match offset 0", { 0x10, 'a', 0x00, 0x00 }, 4, 16, -1 },
+        { "match before the output", { 0x10, 'a', 0x02, 0x00 }, 4, 16, -1 },
+        { "match past the output", { 0x10, 'a', 0x01, 0x00, 0x00 }, 5, 4, -1 },
+        { "match cut short", { 0x10, 'a', 0x01 }, 3, 16, -1 },
+        { "match length runs off the input", { 0x1f, 'a', 0x01, 0x00, 0xff }, 5, 1024, -1 }
+    };
+
+    for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        unsigned char* in = copy(cases[i].bytes, cases[i].len);
+        unsigned char* out = malloc(cases[i].out_len);
+        int result = lz4_decompress(out, cases[i].out_len, in, cases[i].len);
+        if (result != cases[i].result)
+        {
+            printf("FAIL: %s: got %d, wanted %d\n", cases[i].what, result, cases[i].result);
+            s_failures++;
+        }
+        free(out);
+        free(in);
+    }
+
+    srand(1);
+    for (int i = 0; i < 100000; i++)
+    {
+        unsigned char bytes[64];
+        int len = rand() % sizeof(bytes);
+        for (int j = 0; j < len; j++)
+        {
+            bytes[j] = rand();
+        }
+
+        int out_len = rand() % 300;
+        unsigned char* in = copy(bytes, len);
+        unsigned char* out = malloc(out_len != 0 ? out_len : 1);
+        int result = lz4_decompress(out, out_len, in, len);
+        expect(result >= -1 && result <= out_len, "random block stays in bounds", i);
+        free(out);
+        free(in);
+    }
+}
+
+int main()
+{
+    for (int id = 0; id < PAYLOAD_COUNT; id++)
+    {
+        const unsigned char* bytes = payload_get(id);
+        expect(bytes != NULL && memcmp(bytes, "\0asm", 4) == 0, "payload_get", id);
+    }
+    expect(payload_get(-1) == NULL, "payload_get(-1)", 0);
+    expect(payload_get(PAYLOAD_COUNT) == NULL, "payload_get(PAYLOAD_COUNT)", PAYLOAD_COUNT);
+
+    test_blob(s_payload_blob, sizeof(s_payload_blob));
+    test_lz4_blocks(s_payload_blob, sizeof(s_payload_blob));
+    test_lz4_malformed();
+
+    if (s_failures != 0)
+    {
+        printf("%d failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    printf("ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/**
+ * Native tests for the boards in main.c: session_step, as reached through
+ * session_press and the page's press_batch, and submit_code. Built the same
+ * way as payload_test.c, against the stub emscripten.h in tests/stub.
+ *
+ * None of the javascript runs, so as far as main.c can tell a verifier that
+ * isn't linked is still loading (verifier_ready's EM_ASM_INT says 0). The
+ * tests link stand-ins for them straight into s_verifiers once they want
+ * the stages to be checkable.
+ */
+#define main challenge_main
+#include "../src/main.c"
+#undef main
+
+static int s_failures = 0;
+
+static void expect(int p_ok, const char* p_what, int p_got)
+{
+    if (!p_ok)
+    {
+        printf("FAIL: %s (got %d)\n", p_what, p_got);
+        s_failures++;
+    }
+}
+
+// the right code, one digit per row of s_stages
+static const unsigned char s_code[] = { 1, 9, 4, 7, 4, 8, 2 };
+
+static int stage2_verifier(int p_value)
+{
+    return p_value == 9;
+}
+
+static int stage3_verifier(int p_value)
+{
+    return p_value == 4;
+}
+
+static int stage4_verifier(int p_value)
+{
+    return p_value == 7;
+}
+
+static int stage5_verifier(int p_value)
+{
+    return p_value == 4;
+}
+
+static void link_verifiers()
+{
+    s_verifiers[PAYLOAD_STAGE2] = stage2_verifier;
+    s_verifiers[PAYLOAD_STAGE3] = stage3_verifier;
+    s_verifiers[PAYLOAD_STAGE4] = stage4_verifier;
+    s_verifiers[PAYLOAD_STAGE5] = stage5_verifier;
+}
+
+// presses p_digits on p_session, backdating the first press so the timing
+// gate in front of the fifth digit doesn't get in the way. Returns what the
+// last press returned.
+static int press_all(session_t* p_session, const unsigned char* p_digits, int p_count)
+{
+    int result = 0;
+    for (int i = 0; i < p_count; i++)
+    {
+        result = session_press(p_session, p_digits[i]);
+        p_session->first_press -= 60;
+    }
+    return result;
+}
+
+/*
+ * Before the verifiers have loaded. A press for a stage that needs one isn't
+ * applied, on any board, and neither does submit_code check anything.
+ */
+static void test_pending()
+{
+    session_t* session = session_create();
+    expect(session_press(session, 1) == 1, "first digit moves a board on", session->stage);
+
+    session->last_press = 12345;
+    int result = session_press(session, 9);
+    expect(result == STAGE_PENDING, "press for a loading verifier is pending", result);
+    expect(session->stage == 1, "pending press leaves the stage alone", session->stage);
+    expect(session->last_press == 12345, "pending press isn't timed", session->last_press);
+
+    // the page: the press that's pending doesn't count as got through, and
+    // the rest of the batch waits with it
+    int batch[] = { 1, 9, 4, 7 };
+    s_page.stage = 0;
+    result = press_batch(batch, 4);
+    expect(s_page.stage == 1, "page batch stops at the loading stage", s_page.stage);
+    expect(result == 1, "page batch gets through the press before it", result);
+
+    result = press_batch(batch + 1, 3);
+    expect(result == 0, "page batch starting on a pending press gets nowhere", result);
+    expect(s_page.stage == 1, "page stays at the loading stage", s_page.stage);
+
+    result = submit_code(s_code, sizeof(s_code));
+    expect(result == STAGE_PENDING, "submit_code is pending", result);
+
+    // a code that stops before the first verifier doesn't need one
+    result = submit_code(s_code, 1);
+    expect(result == 1, "submit_code of one digit", result);
+
+    session_destroy(session);
+}
+
+/*
+ * With the verifiers linked: a whole code, a wrong digit that resets and one
+ * at the locking stage, and boards that don't see each other's presses.
+ */
+static void test_boards()
+{
+    link_verifiers();
+    s_page.stage = 0;
+
+    session_t* first = session_create();
+    session_t* second = session_create();
+
+    int result = press_all(first, s_code, sizeof(s_code));
+    expect(result == STAGE_COUNT, "right code finishes", result);
+    expect(first->stage == 0, "finished board is back at the start", first->stage);
+
+    // reset: the third digit wrong
+    unsigned char wrong_third[] = { 1, 9, 5 };
+    result = press_all(first, wrong_third, sizeof(wrong_third));
+    expect(result == 0, "wrong digit resets", result);
+    expect(first->stage == 0, "reset board is at the start", first->stage);
+
+    // the other board is still where it was left
+    press_all(second, s_code, 3);
+    expect(second->stage == 3, "second board moves on its own", second->stage);
+    press_all(first, wrong_third, sizeof(wrong_third));
+    expect(second->stage == 3, "a reset elsewhere leaves it alone", second->stage);
+
+    // lock: the fifth digit wrong
+    unsigned char wrong_fifth[] = { 1, 9, 4, 7, 5 };
+    result = press_all(first, wrong_fifth, sizeof(wrong_fifth));
+    expect(result == STAGE_LOCKED, "wrong digit at the lock stage locks", result);
+    result = press_all(first, s_code, sizeof(s_code));
+    expect(result == STAGE_LOCKED, "locked board stays locked", result);
+
+    expect(second->stage == 3, "a lock elsewhere leaves it alone", second->stage);
+    result = press_all(second, s_code + 3, sizeof(s_code) - 3);
+    expect(result == STAGE_COUNT, "second board still finishes", result);
+    expect(s_page.stage == 0, "the page's board never moved", s_page.stage);
+
+    // the page locks on its own board, not anyone else's
+    s_page.first_press = time(NULL) - 60;
+    int page_wrong_fifth[] = { 1, 9, 4, 7, 5 };
+    press_batch(page_wrong_fifth, 5);
+    expect(s_page.stage == STAGE_LOCKED, "page locks", s_page.stage);
+    expect(first->stage == STAGE_LOCKED && second->stage == 0, "page lock is the page's", second->stage);
+
+    session_destroy(second);
+    session_destroy(first);
+}
+
+/*
+ * submit_code checks the code and leaves every board where it was.
+ */
+static void test_submit_code()
+{
+    session_t* session = session_create();
+    press_all(session, s_code, 2);
+    s_page.stage = 3;
+
+    int result = submit_code(s_code, sizeof(s_code));
+    expect(result == -1, "right code", result);
+
+    unsigned char wrong[sizeof(s_code)];
+    for (unsigned int i = 0; i < sizeof(s_code); i++)
+    {
+        memcpy(wrong, s_code, sizeof(s_code));
+        wrong[i] = (wrong[i] + 1) % 10;
+        result = submit_code(wrong, sizeof(wrong));
+        expect(result == (int)i, "first wrong digit", result);
+    }
+
+    result = submit_code(s_code, 4);
+    expect(result == 4, "a short code fails where it stops", result);
+
+    unsigned char longer[sizeof(s_code) + 1];
+    memcpy(longer, s_code, sizeof(s_code));
+    longer[sizeof(s_code)] = 0;
+    result = submit_code(longer, sizeof(longer));
+    expect(result == STAGE_COUNT, "an extra digit fails at STAGE_COUNT", result);
+
+    // the wrong fifth digit would lock a board, not here
+    expect(session->stage == 2, "submit_code leaves boards alone", session->stage);
+    expect(s_page.stage == 3, "submit_code leaves the page alone", s_page.stage);
+    session_destroy(session);
+}
+
+int main()
+{
+    char* argv[] = { "./this.program" };
+    challenge_main(1, argv);
+
+    test_pending();
+    test_boards();
+    test_submit_code();
+
+    if (s_failures != 0)
+    {
+        printf("%d failures\n", s_failures);
+        return EXIT_FAILURE;
+    }
+    printf("ok\n");
+    return EXIT_SUCCESS;
+}
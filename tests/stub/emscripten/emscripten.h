@@ -0,0 +1,36 @@
+/*
+ * Just enough of emscripten.h for main.c to build natively, for the tests and
+ * the native benches. None of the javascript runs: EM_ASM does nothing and
+ * EM_ASM_INT returns 0. Same as the real thing, the code goes first and a
+ * comma in it has to be inside parentheses.
+ */
+#ifndef EMSCRIPTEN_STUB_H
+#define EMSCRIPTEN_STUB_H
+
+#include <time.h>
+
+#define EMSCRIPTEN_KEEPALIVE
+
+static inline int em_asm_stub(int p_unused, ...)
+{
+    (void)p_unused;
+    return 0;
+}
+
+#define EM_ASM(code, ...) ((void)em_asm_stub(0, ##__VA_ARGS__))
+#define EM_ASM_INT(code, ...) em_asm_stub(0, ##__VA_ARGS__)
+
+static inline void emscripten_run_script(const char* p_script)
+{
+    (void)p_script;
+}
+
+// milliseconds, like the real one
+static inline double emscripten_get_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+#endif
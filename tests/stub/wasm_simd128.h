@@ -0,0 +1,35 @@
+/*
+ * The bit of wasm_simd128.h that deobfuscate() uses, on GCC vector
+ * extensions, so the simd path can run natively too. main.c only includes
+ * it when __wasm_simd128__ is defined, which the simd test build does by
+ * hand (see "make test"). Loads are counted so the test can tell the path
+ * actually ran.
+ */
+#ifndef WASM_SIMD128_STUB_H
+#define WASM_SIMD128_STUB_H
+
+#include <string.h>
+
+typedef unsigned char v128_t __attribute__((vector_size(16)));
+
+static int wasm_stub_loads = 0;
+
+static inline v128_t wasm_v128_load(const void* p_mem)
+{
+    v128_t value;
+    memcpy(&value, p_mem, sizeof(value));
+    wasm_stub_loads++;
+    return value;
+}
+
+static inline void wasm_v128_store(void* p_mem, v128_t p_value)
+{
+    memcpy(p_mem, &p_value, sizeof(p_value));
+}
+
+static inline v128_t wasm_v128_xor(v128_t p_a, v128_t p_b)
+{
+    return p_a ^ p_b;
+}
+
+#endif
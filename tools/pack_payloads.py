@@ -0,0 +1,532 @@
+#!/usr/bin/env python3
+"""
+Packs the verifier payloads listed in src/payloads/manifest.txt into the
+blob + index table in src/payloads.h. See the top of the generated header for
+the container layout.
+
+Each payload is xor obfuscated with its key (if any) and then, if asked for
+and if it actually helps, LZ4 block compressed. The decoder in main.c undoes
+that in the opposite order and checks the adler-32 of the result.
+
+With --merged every verifier is folded into a single module (the manifest's
+"-" entry) that exports each one as v<n>, so the page compiles and
+instantiates one module at startup instead of one per stage.
+
+The payloads themselves are assembled from src/payloads/*.wat by the
+Makefile, which only redoes the ones that changed and then reruns this.
+
+Usage: tools/pack_payloads.py [--merged] [--key HEX] [manifest] [output header]
+"""
+
+import argparse
+import os
+import struct
+import zlib
+
+MAGIC = b'WCHL'
+VERSION = 2
+HEADER_SIZE = 20
+FLAG_XOR = 0x01
+FLAG_LZ4 = 0x02
+
+# LZ4 block format constraints
+MIN_MATCH = 4
+LAST_LITERALS = 5
+MF_LIMIT = 12
+MAX_OFFSET = 0xffff
+
+
+def lz4_compress(data):
+    """
+    Greedy LZ4 block compressor. Small and slow, which is fine for payloads
+    that get packed once at build time.
+    """
+    out = bytearray()
+    table = {}
+    anchor = 0
+    pos = 0
+    match_limit = len(data) - MF_LIMIT
+
+    def emit(literals, match_len, offset):
+        lit_len = len(literals)
+        token_lit = min(lit_len, 15)
+        token_match = 0 if match_len is None else min(match_len - MIN_MATCH, 15)
+        out.append((token_lit << 4) | token_match)
+        if lit_len >= 15:
+            rest = lit_len - 15
+            while rest >= 255:
+                out.append(255)
+                rest -= 255
+            out.append(rest)
+        out.extend(literals)
+        if match_len is None:
+            return
+        out.extend(struct.pack('<H', offset))
+        if match_len - MIN_MATCH >= 15:
+            rest = match_len - MIN_MATCH - 15
+            while rest >= 255:
+                out.append(255)
+                rest -= 255
+            out.append(rest)
+
+    while pos < match_limit:
+        key = data[pos:pos + MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = pos
+        if candidate is None or pos - candidate > MAX_OFFSET:
+            pos += 1
+            continue
+
+        # extend the match, leaving the last literals alone
+        length = MIN_MATCH
+        end = len(data) - LAST_LITERALS
+        while pos + length < end and data[candidate + length] == data[pos + length]:
+            length += 1
+
+        emit(data[anchor:pos], length, pos - candidate)
+        pos += length
+        anchor = pos
+
+    emit(data[anchor:], None, 0)
+    return bytes(out)
+
+
+def lz4_decompress(data, size):
+    """ Reference decoder, used to check the compressor's output. """
+    out = bytearray()
+    pos = 0
+    while True:
+        token = data[pos]
+        pos += 1
+        lit_len = token >> 4
+        if lit_len == 15:
+            while True:
+                extra = data[pos]
+                pos += 1
+                lit_len += extra
+                if extra != 255:
+                    break
+        out.extend(data[pos:pos + lit_len])
+        pos += lit_len
+        if pos == len(data):
+            break
+        offset = data[pos] | (data[pos + 1] << 8)
+        pos += 2
+        match_len = token & 0x0f
+        if match_len == 15:
+            while True:
+                extra = data[pos]
+                pos += 1
+                match_len += extra
+                if extra != 255:
+                    break
+        match_len += MIN_MATCH
+        for _ in range(match_len):
+            out.append(out[-offset])
+    if len(out) != size:
+        raise ValueError('lz4 round trip produced %d bytes, wanted %d' % (len(out), size))
+    return bytes(out)
+
+
+def xor(data, key):
+    if not key:
+        return data
+    return bytes(b ^ key[i % len(key)] for i, b in enumerate(data))
+
+
+def read_uleb(data, pos):
+    result = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        result |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            return result, pos
+
+
+def skip_sleb(data, pos):
+    while data[pos] & 0x80:
+        pos += 1
+    return pos + 1
+
+
+def uleb(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def wasm_vec(items):
+    return uleb(len(items)) + b''.join(items)
+
+
+def wasm_name(text):
+    return uleb(len(text)) + text.encode()
+
+
+def wasm_section(section_id, payload):
+    return bytes([section_id]) + uleb(len(payload)) + payload
+
+
+def read_sections(raw):
+    if raw[:8] != b'\x00asm\x01\x00\x00\x00':
+        raise ValueError('not a wasm module')
+    sections = {}
+    pos = 8
+    while pos < len(raw):
+        section_id = raw[pos]
+        size, pos = read_uleb(raw, pos + 1)
+        if section_id != 0:
+            sections[section_id] = raw[pos:pos + size]
+        pos += size
+    return sections
+
+
+# opcodes whose immediates are a single uleb: br, br_if, local.get/set/tee
+ULEB_IMMEDIATE = {0x0c, 0x0d, 0x20, 0x21, 0x22}
+
+
+def check_body(body, name):
+    """
+    Walks a function body and makes sure it doesn't reference anything by
+    index besides its own locals (calls, globals, tables, typed blocks). Those
+    would need renumbering in the merged module and none of the verifiers
+    need them.
+    """
+    count, pos = read_uleb(body, 0)
+    for _ in range(count):
+        _, pos = read_uleb(body, pos)
+        pos += 1
+
+    while pos < len(body):
+        opcode = body[pos]
+        pos += 1
+        if opcode in (0x02, 0x03, 0x04):
+            if body[pos] != 0x40 and body[pos] < 0x7c:
+                raise ValueError('%s: typed block can\'t be merged' % name)
+            pos += 1
+        elif opcode in ULEB_IMMEDIATE:
+            _, pos = read_uleb(body, pos)
+        elif opcode == 0x0e:
+            count, pos = read_uleb(body, pos)
+            for _ in range(count + 1):
+                _, pos = read_uleb(body, pos)
+        elif 0x28 <= opcode <= 0x3e:
+            _, pos = read_uleb(body, pos)
+            _, pos = read_uleb(body, pos)
+        elif opcode in (0x3f, 0x40):
+            pos += 1
+        elif opcode in (0x41, 0x42):
+            pos = skip_sleb(body, pos)
+        elif opcode == 0x43:
+            pos += 4
+        elif opcode == 0x44:
+            pos += 8
+        elif opcode in (0x00, 0x01, 0x05, 0x0b, 0x0f, 0x1a, 0x1b) or 0x45 <= opcode <= 0xc4:
+            pass
+        else:
+            raise ValueError('%s: opcode 0x%02x can\'t be merged' % (name, opcode))
+
+
+def merge_modules(modules):
+    """
+    Folds single-verifier modules into one module exporting verifier n as
+    v<n>. Each input may import env.memory and must export exactly one
+    function. Anything fancier is refused rather than merged wrong.
+    """
+    types = []
+    funcs = []
+    bodies = []
+    memory_min = None
+    for name, raw in modules:
+        sections = read_sections(raw)
+        unknown = set(sections) - {1, 2, 3, 7, 10}
+        if unknown:
+            raise ValueError('%s: sections %s can\'t be merged' % (name, sorted(unknown)))
+
+        # types, kept as raw bytes so identical signatures dedupe
+        module_types = []
+        data = sections.get(1, b'\x00')
+        count, pos = read_uleb(data, 0)
+        for _ in range(count):
+            start = pos
+            params, pos = read_uleb(data, pos + 1)
+            pos += params
+            results, pos = read_uleb(data, pos)
+            pos += results
+            module_types.append(data[start:pos])
+
+        data = sections.get(2, b'\x00')
+        count, pos = read_uleb(data, 0)
+        for _ in range(count):
+            length, pos = read_uleb(data, pos)
+            module_name = data[pos:pos + length]
+            pos += length
+            length, pos = read_uleb(data, pos)
+            field = data[pos:pos + length]
+            pos += length
+            if module_name != b'env' or field != b'memory' or data[pos] != 2 or data[pos + 1] != 0:
+                raise ValueError('%s: only an env.memory import can be merged' % name)
+            minimum, pos = read_uleb(data, pos + 2)
+            memory_min = max(memory_min or 0, minimum)
+
+        data = sections[3]
+        count, pos = read_uleb(data, 0)
+        func_types = []
+        for _ in range(count):
+            index, pos = read_uleb(data, pos)
+            func_types.append(index)
+
+        data = sections[7]
+        count, pos = read_uleb(data, 0)
+        exported = []
+        for _ in range(count):
+            length, pos = read_uleb(data, pos)
+            pos += length
+            kind = data[pos]
+            index, pos = read_uleb(data, pos + 1)
+            if kind == 0:
+                exported.append(index)
+        if len(exported) != 1:
+            raise ValueError('%s: needs exactly one exported function' % name)
+
+        data = sections[10]
+        count, pos = read_uleb(data, 0)
+        module_bodies = []
+        for _ in range(count):
+            size, pos = read_uleb(data, pos)
+            module_bodies.append(data[pos:pos + size])
+            pos += size
+
+        signature = module_types[func_types[exported[0]]]
+        if signature not in types:
+            types.append(signature)
+        check_body(module_bodies[exported[0]], name)
+        funcs.append(types.index(signature))
+        bodies.append(module_bodies[exported[0]])
+
+    merged = b'\x00asm\x01\x00\x00\x00'
+    merged += wasm_section(1, wasm_vec(types))
+    if memory_min is not None:
+        merged += wasm_section(2, wasm_vec([wasm_name('env') + wasm_name('memory') + b'\x02\x00' + uleb(memory_min)]))
+    merged += wasm_section(3, wasm_vec([uleb(index) for index in funcs]))
+    merged += wasm_section(7, wasm_vec([wasm_name('v%d' % i) + b'\x00' + uleb(i) for i in range(len(funcs))]))
+    merged += wasm_section(10, wasm_vec([uleb(len(body)) + body for body in bodies]))
+    return merged
+
+
+def read_manifest(path):
+    entries = []
+    with open(path) as manifest:
+        for line in manifest:
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            fields = line.split(None, 5)
+            if len(fields) < 5:
+                raise ValueError('bad manifest line: ' + line)
+            ident, filename, export, key, compression = fields[:5]
+            if compression not in ('lz4', 'raw'):
+                raise ValueError('unknown compression %s for %s' % (compression, ident))
+            entries.append({
+                'id': ident,
+                'file': filename,
+                'export': export,
+                'key': None if key == '*' else b'' if key == '-' else bytes.fromhex(key),
+                'compression': compression,
+                'description': fields[5] if len(fields) > 5 else '',
+            })
+    return entries
+
+
+def container(raw, key, compression):
+    obfuscated = xor(raw, key)
+    stored = obfuscated
+    flags = FLAG_XOR if key else 0
+    if compression == 'lz4':
+        compressed = lz4_compress(obfuscated)
+        if lz4_decompress(compressed, len(obfuscated)) != obfuscated:
+            raise ValueError('lz4 round trip mismatch')
+        if len(compressed) < len(obfuscated):
+            stored = compressed
+            flags |= FLAG_LZ4
+
+    header = MAGIC + struct.pack('<BBBBIII', VERSION, flags, len(key), 0,
+                                 len(raw), len(stored), zlib.adler32(raw))
+    return header + key + stored, flags, len(stored)
+
+
+def c_bytes(data, indent='    ', per_line=12):
+    lines = []
+    for i in range(0, len(data), per_line):
+        lines.append(indent + ', '.join('0x%02x' % b for b in data[i:i + per_line]) + ',')
+    return '\n'.join(lines)
+
+
+HEADER_TEMPLATE = '''/**
+ * GENERATED by tools/pack_payloads.py from src/payloads/manifest.txt. Don't
+ * edit by hand, change the manifest (or the payloads) and run "make payloads".
+ *
+ * Every verifier payload, packed into one read-only blob with an index table
+ * in front of it. The handlers never touch these bytes directly: they ask for
+ * a payload by id (see payload_get() in main.c), which finds the entry here,
+ * validates and decodes it into the staging buffer and hands that to the
+ * javascript.
+ *
+ * Each payload in the blob is a small container:
+ *
+ *   offset  size      field
+ *   0       4         magic, "WCHL"
+ *   4       1         version, PAYLOAD_VERSION
+ *   5       1         flags, PAYLOAD_FLAG_*
+ *   6       1         key length (zero unless PAYLOAD_FLAG_XOR)
+ *   7       1         reserved, zero
+ *   8       4         payload length, little endian
+ *   12      4         stored length, little endian
+ *   16      4         adler-32 of the decoded payload, little endian
+ *   20      key len   xor key, rolled over the payload
+ *   ...     stored    payload
+ *
+ * The payload is xor'd with the key first and then (PAYLOAD_FLAG_LZ4) LZ4
+ * block compressed. The checksum covers the bytes after decoding, so a
+ * corrupt payload and a wrong key are both caught before anything gets near
+ * the compiler.
+ *
+%(summary)s
+ */
+#ifndef PAYLOADS_H
+#define PAYLOADS_H
+
+#define PAYLOAD_MAGIC "WCHL"
+#define PAYLOAD_VERSION %(version)d
+#define PAYLOAD_HEADER_SIZE %(header_size)d
+
+// the payload is xor obfuscated with the key that follows the header
+#define PAYLOAD_FLAG_XOR 0x%(flag_xor)02x
+
+// the (obfuscated) payload is LZ4 block compressed
+#define PAYLOAD_FLAG_LZ4 0x%(flag_lz4)02x
+
+// the largest decoded payload, which sizes the staging buffer
+#define PAYLOAD_MAX_LENGTH %(max_length)d
+%(merged)s
+enum
+{
+%(ids)s
+    PAYLOAD_COUNT
+};
+
+typedef struct
+{
+    // where the container starts in s_payload_blob
+    unsigned int offset;
+
+    // the export the javascript calls with the pressed digit
+    const char* export_name;
+} payload_t;
+
+static const unsigned char s_payload_blob[%(blob_size)d] =
+{
+%(blob)s
+};
+
+static const payload_t s_payloads[PAYLOAD_COUNT] =
+{
+%(index)s
+};
+
+#endif
+'''
+
+
+def main():
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+    parser = argparse.ArgumentParser(description='Packs the verifier payloads into src/payloads.h')
+    parser.add_argument('--merged', action='store_true', help='fold every verifier into one module')
+    parser.add_argument('--key', type=bytes.fromhex, default=None, help='xor key (hex) for manifest entries keyed "*"')
+    parser.add_argument('manifest', nargs='?', default=os.path.join(root, 'src/payloads/manifest.txt'))
+    parser.add_argument('output', nargs='?', default=os.path.join(root, 'src/payloads.h'))
+    args = parser.parse_args()
+
+    entries = read_manifest(args.manifest)
+    for entry in entries:
+        if entry['key'] is None:
+            if not args.key:
+                raise ValueError('%s wants the configured key but no --key given' % entry['id'])
+            entry['key'] = args.key
+    for entry in entries:
+        if entry['file'] != '-':
+            with open(os.path.join(os.path.dirname(args.manifest), entry['file']), 'rb') as payload:
+                entry['raw'] = payload.read()
+
+    # the "-" entry is the merged module. Only packed with --merged, where it
+    # stands in for every other payload.
+    merged = [entry for entry in entries if entry['file'] == '-']
+    if len(merged) > 1:
+        raise ValueError('only one merged entry allowed')
+    if args.merged:
+        if not merged:
+            raise ValueError('--merged needs a "-" entry in the manifest')
+        verifiers = [entry for entry in entries if entry['file'] != '-']
+        merged[0]['raw'] = merge_modules([(entry['id'], entry['raw']) for entry in verifiers])
+        for i, entry in enumerate(verifiers):
+            entry['export'] = 'v%d' % i
+            entry['packed_as'] = merged[0]
+    else:
+        entries = [entry for entry in entries if entry['file'] != '-']
+
+    blob = []
+    index = []
+    summary = [' * id                raw  stored  flags']
+    offset = 0
+    max_length = 0
+    total_raw = 0
+    for entry in entries:
+        if 'packed_as' in entry:
+            continue
+
+        raw = entry['raw']
+        packed, flags, stored = container(raw, entry['key'], entry['compression'])
+        flag_names = [name for bit, name in ((FLAG_XOR, 'xor'), (FLAG_LZ4, 'lz4')) if flags & bit]
+        blob.append('    // %s @ %d: %s\n%s' % (entry['id'], offset, entry['description'], c_bytes(packed)))
+        summary.append(' * %-16s %4d  %6d  %s' % (entry['id'], len(raw), stored, ' '.join(flag_names) or '-'))
+        print('%-16s %5d -> %5d bytes %s' % (entry['id'], len(raw), stored, ' '.join(flag_names)))
+
+        entry['offset'] = offset
+        offset += len(packed)
+        max_length = max(max_length, len(raw))
+        total_raw += len(raw)
+
+    for entry in entries:
+        packed_offset = entry['packed_as']['offset'] if 'packed_as' in entry else entry['offset']
+        export = '0' if entry['export'] == '-' else '"%s"' % entry['export']
+        index.append('    { %d, %s }, // %s' % (packed_offset, export, entry['id']))
+
+    print('blob: %d bytes for %d bytes of payload' % (offset, total_raw))
+    with open(args.output, 'w') as header:
+        header.write(HEADER_TEMPLATE % {
+            'summary': '\n'.join(summary),
+            'version': VERSION,
+            'header_size': HEADER_SIZE,
+            'flag_xor': FLAG_XOR,
+            'flag_lz4': FLAG_LZ4,
+            'max_length': max_length,
+            'merged': ('\n// every verifier lives in PAYLOAD_MERGED, instantiated once at startup\n'
+                       '#define PAYLOADS_MERGED 1\n') if args.merged else '',
+            'ids': '\n'.join('    %s,' % entry['id'] for entry in entries),
+            'blob_size': offset,
+            'blob': '\n\n'.join(blob),
+            'index': '\n'.join(index),
+        })
+
+
+if __name__ == '__main__':
+    main()